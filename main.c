@@ -1,9 +1,128 @@
+/* PN_HT_THREADS/PN_HT_STATS builds: pn_serializer.h includes the system headers first, so ask for POSIX here */
+#if !defined(_WIN32) && defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE)
+  #define _POSIX_C_SOURCE 200112L
+#endif
 
 #define PN_SERIALIZER_IMPLEMENTATION
 #include "pn_serializer.h"
 #define PN_HASHTABLE_IMPLEMENTATION
 #include "pn_hashtable.h"
 
+#define SAMPLE_COUNT (1 << 18)      // Enough to span several stream chunks and compressed blocks
+
+static int Failures = 0;
+
+static void Check(const char* lpstrName, int Ok)
+{
+    printf("%-24s%s\n", lpstrName, Ok ? "ok" : "FAILED");
+    Failures += !Ok;
+    return;
+}
+
+// Keeps the first half of a file, cutting off whatever trailer or index it ends with
+static int TruncateFile(const char* lpstrFilename)
+{
+    FILE* pFile = fopen(lpstrFilename, "rb");
+    char* pBytes = NULL;
+    long Size = -1;
+    int Ok = 0;
+
+    if (pFile == NULL) return 0;
+    if (fseek(pFile, 0, SEEK_END) == 0) Size = ftell(pFile);
+    if (Size > 0 && (pBytes = (char*)malloc(Size)) != NULL && fseek(pFile, 0, SEEK_SET) == 0)
+        Ok = fread(pBytes, 1, Size, pFile) == (size_t)Size;
+    fclose(pFile);
+
+    if (Ok && (pFile = fopen(lpstrFilename, "wb")) != NULL)
+    {
+        Ok = fwrite(pBytes, 1, Size / 2, pFile) == (size_t)(Size / 2);
+        Ok = fclose(pFile) == 0 && Ok;
+    }
+    free(pBytes);
+    return Ok;
+}
+
+static void WriteSample(PNSERIALIZERPTR pData)
+{
+    int16_t pShorts[3] = { -1, 0, 32767 };
+    int64_t pLongs[2] = { -480000000000LL, 1LL << 62 };
+    float pFloats[2] = { 0.5f, -654.321f };
+    double pDoubles[2] = { 1e300, -987.654 };
+    int32_t k;
+
+    PnWriteString(pData, "This Is A String", -1);
+    PnWriteInt16(pData, -1200);
+    PnWriteInt32(pData, 24000);
+    PnWriteInt64(pData, -480000);
+    PnWriteFloat32(pData, 654.321f);
+    PnWriteFloat64(pData, 987.654);
+    PnWriteInt16Array(pData, pShorts, 3);
+    PnWriteInt64Array(pData, pLongs, 2);
+    PnWriteFloat32Array(pData, pFloats, 2);
+    PnWriteFloat64Array(pData, pDoubles, 2);
+    for (k = 0; k < SAMPLE_COUNT; k++)
+        PnWriteInt32(pData, k * 7 - SAMPLE_COUNT);
+    return;
+}
+
+// Reads back what WriteSample wrote and ends the deserialization, 1 if everything matched and PN_SER_ERROR stayed clear
+static int CheckSample(PNSERIALIZERPTR pData)
+{
+    char* lpstrString = NULL;
+    int16_t* pShorts = NULL;
+    int64_t* pLongs = NULL;
+    float* pFloats = NULL;
+    double* pDoubles = NULL;
+    uint32_t nShorts, nLongs, nFloats, nDoubles;
+    int32_t k;
+    int Ok;
+
+    PnReadString(pData, &lpstrString, NULL);
+    Ok = lpstrString != NULL && strcmp(lpstrString, "This Is A String") == 0;
+    Ok = PnReadInt16(pData) == -1200 && Ok;
+    Ok = PnReadInt32(pData) == 24000 && Ok;
+    Ok = PnReadInt64(pData) == -480000 && Ok;
+    Ok = PnReadFloat32(pData) == 654.321f && Ok;
+    Ok = PnReadFloat64(pData) == 987.654 && Ok;
+    PnReadInt16Array(pData, &pShorts, &nShorts);
+    PnReadInt64Array(pData, &pLongs, &nLongs);
+    PnReadFloat32Array(pData, &pFloats, &nFloats);
+    PnReadFloat64Array(pData, &pDoubles, &nDoubles);
+    Ok = Ok && nShorts == 3 && pShorts[0] == -1 && pShorts[1] == 0 && pShorts[2] == 32767;
+    Ok = Ok && nLongs == 2 && pLongs[0] == -480000000000LL && pLongs[1] == 1LL << 62;
+    Ok = Ok && nFloats == 2 && pFloats[0] == 0.5f && pFloats[1] == -654.321f;
+    Ok = Ok && nDoubles == 2 && pDoubles[0] == 1e300 && pDoubles[1] == -987.654;
+    for (k = 0; k < SAMPLE_COUNT; k++)
+        Ok = PnReadInt32(pData) == k * 7 - SAMPLE_COUNT && Ok;
+
+    Ok = !(pData->Flags & PN_SER_ERROR) && Ok;
+    void* pMemBlocks[] = { lpstrString, pShorts, pLongs, pFloats, pDoubles };
+    return PnDeserializationEnd(pData, pMemBlocks, 5) && Ok;
+}
+
+// Writes the sample with "Flags" (PN_SER_STREAM, PN_SER_VARINT, PN_SER_COMPRESS) and reads it back, mapped if PN_SER_MAPPED
+static int RoundTrip(const char* lpstrFilename, uint32_t Flags)
+{
+    PNSERIALIZER Data = { 0 };
+    int Ok = 1;
+
+    if (Flags & PN_SER_STREAM)
+        Ok = PnSerializationBeginStream(&Data, lpstrFilename);
+    else
+        PnSerializationBegin(&Data);
+    if (!Ok) return 0;
+
+    PnSerializerSetFlags(&Data, Flags);
+    WriteSample(&Data);
+    if (!PnSerializationEnd(&Data, lpstrFilename)) return 0;
+
+    Ok = (Flags & PN_SER_MAPPED) ? PnDeserializationBeginMapped(&Data, lpstrFilename) : PnDeserializationBegin(&Data, lpstrFilename);
+    if (!Ok) return 0;
+
+    PnSerializerSetFlags(&Data, Flags);
+    return CheckSample(&Data);
+}
+
 static void TestSerializer()
 {
     PNSERIALIZER Data = { 0 };
@@ -40,16 +159,132 @@ static void TestSerializer()
     printf("Deserialized-Int64:   %I64d\n", PnReadInt64(&Data));
     printf("Deserialized-Float32: %g\n", PnReadFloat32(&Data));
     printf("Deserialized-Float64: %g\n", PnReadFloat64(&Data));
-    void* pMemBlocks[] = { lpstrString, pDate, pOutNums };
-    PnDeserializationEnd(&Data, pMemBlocks, 3);         // Or call free yourself (not sure about this)
+    void* pMemBlocks[] = { lpstrString, pOutNums };     // Not "pDate", it is localtime's own buffer
+    PnDeserializationEnd(&Data, pMemBlocks, 2);         // Or call free yourself (not sure about this)
+
+    // Round-trips, every one of them also covers the array readers and writers
+    Check("Round-trip-Buffered:", RoundTrip("rt.bin", PN_SER_NONE));
+    Check("Round-trip-Stream:", RoundTrip("rt.bin", PN_SER_STREAM));
+    Check("Round-trip-Mapped:", RoundTrip("rt.bin", PN_SER_MAPPED));
+    Check("Round-trip-Varint:", RoundTrip("rt.bin", PN_SER_VARINT | PN_SER_MAPPED));
+    Check("Round-trip-Compress:", RoundTrip("rt.bin", PN_SER_COMPRESS));
+    Check("Round-trip-Stream-Zip:", RoundTrip("rt.bin", PN_SER_STREAM | PN_SER_COMPRESS | PN_SER_VARINT));
+
+    // A truncated compressed file is refused, and reading on regardless reports PN_SER_ERROR
+    Check("Truncated-Compress:", RoundTrip("rt.bin", PN_SER_COMPRESS) && TruncateFile("rt.bin") &&
+          !PnDeserializationBegin(&Data, "rt.bin") && (PnReadInt32(&Data), (Data.Flags & PN_SER_ERROR) != 0) &&
+          !PnDeserializationEnd(&Data, NULL, 0));
+    remove("rt.bin");
 
     printf("\n");
     return;
 }
 
+// Keys "Key-<k>" with "k" itself as the value, the tables below copy both (PN_HT_COPY_KV)
+static void InsertKeys(PNHASHTABLEPTR pTable, int First, int Last)
+{
+    char lpstrKey[16];
+    int k;
+
+    for (k = First; k < Last; k++)
+        PnHtInsert(pTable, lpstrKey, sprintf(lpstrKey, "Key-%d", k), &k, sizeof(k));
+    return;
+}
+
+static int RemoveKeys(PNHASHTABLEPTR pTable, int First, int Last)
+{
+    char lpstrKey[16];
+    int k, nRemoved = 0;
+
+    for (k = First; k < Last; k++)
+        nRemoved += PnHtRemove(pTable, lpstrKey, sprintf(lpstrKey, "Key-%d", k));
+    return nRemoved;
+}
+
+// Number of keys in [First, Last) found with the right value
+static int FindKeys(PNHASHTABLEPTR pTable, int First, int Last)
+{
+    char lpstrKey[16];
+    int k, nFound = 0;
+
+    for (k = First; k < Last; k++)
+    {
+        int* pValue = (int*)PnHtGet(pTable, lpstrKey, sprintf(lpstrKey, "Key-%d", k));
+        nFound += pValue != NULL && *pValue == k;
+    }
+    return nFound;
+}
+
+#ifdef PN_HT_THREADS
+#define HTC_THREADS 4
+#define HTC_KEYS    5000
+
+typedef struct
+{
+    PNHTCONCURRENTPTR pTable;
+    int               Id;
+    int               nBad;   /* Own keys missing right after their insert, or any value read back wrong */
+} HTCJOB;
+
+// Inserts its own keys and reads them back, while also reading the keys the other threads are inserting
+PN_HT_THREAD_PROC(ConcurrentJob, pArg)
+{
+    HTCJOB* pJob = (HTCJOB*)pArg;
+    char lpstrKey[16];
+    size_t kSize, vSize;
+    int k, Value;
+
+    for (k = pJob->Id * HTC_KEYS; k < (pJob->Id + 1) * HTC_KEYS; k++)
+    {
+        kSize = sprintf(lpstrKey, "Key-%d", k);
+        PnHtcInsert(pJob->pTable, lpstrKey, kSize, &k, sizeof(k));
+        pJob->nBad += !PnHtcGet(pJob->pTable, lpstrKey, kSize, &Value, sizeof(Value), &vSize) || Value != k || vSize != sizeof(k);
+
+        kSize = sprintf(lpstrKey, "Key-%d", (k + HTC_KEYS) % (HTC_THREADS * HTC_KEYS));
+        if (PnHtcGet(pJob->pTable, lpstrKey, kSize, &Value, sizeof(Value), &vSize))
+            pJob->nBad += Value != (k + HTC_KEYS) % (HTC_THREADS * HTC_KEYS) || vSize != sizeof(k);
+    }
+    return PN_HT_THREAD_RETURN;
+}
+
+// PNHTCONCURRENT: threads inserting and reading at once (through the resizes) lose nothing and read nothing torn
+static void TestConcurrent()
+{
+    PNHTCONCURRENT Table = PnHtcCreate(PN_HT_COPY_KV, 0.5, NULL, 16);
+    HTCJOB pJobs[HTC_THREADS];
+    PNHTTHREAD pThreads[HTC_THREADS];
+    char lpstrKey[16];
+    size_t vSize;
+    int k, Value, nStarted = 0, Ok = 1;
+
+    for (k = 0; k < HTC_THREADS; k++)
+    {
+        pJobs[k].pTable = &Table;
+        pJobs[k].Id = k;
+        pJobs[k].nBad = 0;
+        if (_PnThread_Start(&pThreads[k], ConcurrentJob, &pJobs[k])) nStarted++;
+        else break;
+    }
+    for (k = 0; k < nStarted; k++)
+    {
+        _PnThread_Join(pThreads[k]);
+        Ok = pJobs[k].nBad == 0 && Ok;
+    }
+
+    Ok = Ok && nStarted == HTC_THREADS && PnHtcCount(&Table) == HTC_THREADS * HTC_KEYS;
+    for (k = 0; k < HTC_THREADS * HTC_KEYS && Ok; k++)
+        Ok = PnHtcGet(&Table, lpstrKey, sprintf(lpstrKey, "Key-%d", k), &Value, sizeof(Value), &vSize) && Value == k && vSize == sizeof(k);
+    Check("Concurrent-Insert-Get:", Ok);
+    PnHtcDestroy(&Table);
+    return;
+}
+#endif // PN_HT_THREADS
+
 static void TestHashtable()
 {
     PNHASHTABLE Table = PnHtCreate(PN_HT_NONE, 0.1F, NULL, 10);
+    int Ok, k, nMigrating;
+    size_t GrownCap;
 
     PnHtInsert(&Table, "Key-0", 5, "This is the Value-0", 19);
     PnHtInsert(&Table, "Key-1", 5, "This is the Value-1", 19);
@@ -64,6 +299,59 @@ static void TestHashtable()
 
     PnHtDestroy(&Table);
 
+    // Images: every key is found in the mapped file, a missing or truncated one gives an empty read-only table
+    Table = PnHtCreate(PN_HT_COPY_KV, 0.5, NULL, 0);
+    InsertKeys(&Table, 0, 1000);
+    Ok = PnHtSaveImage(&Table, "table.img");
+    PnHtDestroy(&Table);
+    Table = PnHtOpenImage("table.img", NULL);
+    Check("Image-Lookups:", Ok && Table.pImage != NULL && FindKeys(&Table, 0, 1000) == 1000 && FindKeys(&Table, 1000, 1100) == 0);
+    PnHtDestroy(&Table);
+
+    remove("missing.img");
+    Table = PnHtOpenImage("missing.img", NULL);
+    Check("Image-Missing:", Table.pImage == NULL && FindKeys(&Table, 0, 10) == 0 && !PnHtInsert(&Table, "Key-0", 5, "", 1));
+    PnHtDestroy(&Table);
+
+    Ok = TruncateFile("table.img");
+    Table = PnHtOpenImage("table.img", NULL);
+    Check("Image-Truncated:", Ok && Table.pImage == NULL && FindKeys(&Table, 0, 1000) == 0 && !PnHtContains(&Table, "Key-1", 5));
+    PnHtDestroy(&Table);
+    remove("table.img");
+
+    // PN_HT_INCREMENTAL: while buckets are still being migrated every key is found, old or new
+    Table = PnHtCreate(PN_HT_COPY_KV | PN_HT_INCREMENTAL, 0.5, NULL, 16);
+    nMigrating = 0;
+    Ok = 1;
+    for (k = 0; k < 2000; k++)
+    {
+        InsertKeys(&Table, k, k + 1);
+        if (Table.pOldBuckets != NULL)
+        {
+            nMigrating++;
+            Ok = FindKeys(&Table, 0, k + 1) == k + 1 && Ok;
+        }
+    }
+    Check("Incremental-Lookups:", Ok && nMigrating > 0 && Table.Count == 2000 && FindKeys(&Table, 0, 2000) == 2000);
+    PnHtDestroy(&Table);
+
+    // Removals shrink the table back down, chained and open addressing, and the keys left are still found
+    for (k = 0; k < 2; k++)
+    {
+        Table = PnHtCreate(PN_HT_COPY_KV | (k ? PN_HT_OPEN_ADDRESSING : 0), 0.5, NULL, 16);
+        PnHtSetMinLoad(&Table, 0.1);
+        InsertKeys(&Table, 0, 2000);
+        GrownCap = Table.Cap;
+        Ok = RemoveKeys(&Table, 10, 2000) == 1990 && RemoveKeys(&Table, 10, 20) == 0;
+        Check(k ? "Shrink-Open-Addressing:" : "Shrink-Chained:", Ok && Table.Count == 10 && Table.Cap < GrownCap / 8 &&
+              Table.Cap >= 16 && FindKeys(&Table, 0, 10) == 10 && FindKeys(&Table, 10, 2000) == 0);
+        PnHtDestroy(&Table);
+    }
+
+#ifdef PN_HT_THREADS
+    TestConcurrent();
+#endif // PN_HT_THREADS
+
     printf("\n");
     return;
 }
@@ -73,5 +361,5 @@ int main()
     TestSerializer();
     TestHashtable();
 
-    return 0;
+    return Failures != 0;
 }
@@ -0,0 +1,503 @@
+/* clock_gettime is POSIX, strict -std=cXX builds only declare it on request */
+#if !defined(_WIN32) && defined(__STRICT_ANSI__) && !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE)
+  #define _POSIX_C_SOURCE 200112L
+#endif
+
+#define PN_HASHTABLE_IMPLEMENTATION
+#include "pn_hashtable.h"
+#define PN_SERIALIZER_IMPLEMENTATION
+#include "pn_serializer.h"
+
+#include <math.h>
+
+/**
+ * Hot path benchmarks, results go to stdout as CSV:
+ *     cc -O2 -o pn_bench pn_bench.c -lm && ./pn_bench [MaxEntries] > results.csv
+ *
+ * MaxEntries defaults to 1M (sizes 1K, 10K, ... up to it), pass 100000000 for the full sweep (~16GB).
+ * Columns: bench,table,hasher,dist,key_len,entries,ops,ns_per_op,mb_per_s ("-" where not relevant).
+ *   insert/get_hit/get_miss/remove  one full table per (table, dist, key_len), default (wy) hasher
+ *   hasher_<op>                     the same at key_len 16/uniform for each built-in hasher
+ *   resize                          one PnHtResize to twice the capacity, ns_per_op is the whole call
+ *   hash                            raw hasher throughput over a warm buffer
+ *   get_single/get_batch            PnHtGet vs PnHtGetBatch over the same random lookups
+ *   write_<type>/read_<type>        PnWrite* and PnRead* into and out of a pre-sized buffer
+ *   write_<int>_varint/read_<int>_varint  the same with PN_SER_VARINT on small values
+ *   write_float64_array/read_float64_array  PnWriteFloat64Array and PnReadFloat64Array, one call each
+ *   write_bytes_grow                write_bytes without PnSerializerReserve
+ *   write_int64_stream              write_int64 through PnSerializationBeginStream, including the file I/O
+ *   write_int64_compressed/read_int64_compressed  the same with PN_SER_COMPRESS, reads include loading
+ *   read_bytes_view                 read_bytes through PnDeserializationBeginMapped and PnReadBytesView
+ *
+ * PnHtGetBatch vs PnHtGet: while the table fits in L2 the batch version gains nothing (slightly slower
+ * from the extra passes), once it spills out of the last-level cache expect ~1.5x at a few hundred MB
+ * growing towards 2-4x on multi-GB tables, where every lookup would otherwise stall on DRAM.
+**/
+
+#define BENCH_MAX_LOOKUPS  (1u << 20)
+#define BENCH_MAX_KEY      64
+#define BENCH_ZIPF_THETA   0.99
+#define BENCH_FILE         "pn_bench.bin"
+
+typedef struct __sBENCHHASHER
+{
+    const char*       lpstrName;
+    pfn_Hasher*       Hash;        /* Unseeded hasher, or NULL for SeededHash */
+    pfn_SeededHasher* SeededHash;
+} BENCHHASHER;
+
+static const BENCHHASHER g_Hashers[] = {
+    { "wy",      NULL,                    &PnHashWy  },
+    { "aes",     NULL,                    &PnHashAes },
+    { "legacy0", &_pn_default_hash_func0, NULL       },
+    { "legacy1", &_pn_default_hash_func1, NULL       },
+};
+
+static const char s_KeyChars[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz-_";
+
+/* Same monotonic sources as the PN_HT_STATS resize timer */
+static double BenchNow()
+{
+#ifdef _WIN32
+    LARGE_INTEGER Now, Frequency;
+    QueryPerformanceCounter(&Now);
+    QueryPerformanceFrequency(&Frequency);
+    return (double)(Now.QuadPart / Frequency.QuadPart) + (double)(Now.QuadPart % Frequency.QuadPart) / (double)Frequency.QuadPart;
+#else
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (double)Now.tv_sec + (double)Now.tv_nsec * 1e-9;
+#endif // _WIN32
+}
+
+static uint64_t BenchRandom(uint64_t* pState)
+{
+    uint64_t x = (*pState += 0x9E3779B97F4A7C15ULL);
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+static double BenchUniform(uint64_t* pState)
+{
+    return (double)(BenchRandom(pState) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+/* Printable key of Len bytes, unique for Index < 64^min(Len, 8); no NULs since the table compares with strncmp */
+static void BenchKey(char* pKey, uint64_t Index, size_t Len)
+{
+    size_t k;
+    for (k = Len; k-- > 0; Index >>= 6)
+        pKey[k] = s_KeyChars[Index & 63];
+    return;
+}
+
+/* Lookup indices in [0, nEntries): uniform, or Zipfian (YCSB generator) with the hot ranks scattered */
+static void BenchIndices(uint64_t* pIndices, size_t nIndices, size_t nEntries, int Zipf, uint64_t* pState)
+{
+    double Zeta2 = 1.0 + pow(0.5, BENCH_ZIPF_THETA), ZetaN = 0.0, Alpha, Eta;
+    size_t k;
+
+    if (!Zipf)
+    {
+        for (k = 0; k < nIndices; k++)
+            pIndices[k] = BenchRandom(pState) % nEntries;
+        return;
+    }
+
+    for (k = 1; k <= nEntries; k++)
+        ZetaN += pow((double)k, -BENCH_ZIPF_THETA);
+    Alpha = 1.0 / (1.0 - BENCH_ZIPF_THETA);
+    Eta = (1.0 - pow(2.0 / (double)nEntries, 1.0 - BENCH_ZIPF_THETA)) / (1.0 - Zeta2 / ZetaN);
+
+    for (k = 0; k < nIndices; k++)
+    {
+        double u = BenchUniform(pState), uz = u * ZetaN;
+        uint64_t Rank;
+
+        if (uz < 1.0)
+            Rank = 0;
+        else if (uz < Zeta2)
+            Rank = 1;
+        else
+            Rank = (uint64_t)((double)nEntries * pow(Eta * u - Eta + 1.0, Alpha));
+        if (Rank >= nEntries)
+            Rank = nEntries - 1;
+
+        pIndices[k] = (Rank * 0x9E3779B97F4A7C15ULL) % nEntries;
+    }
+
+    return;
+}
+
+static PNHASHTABLE BenchCreate(uint32_t Flags, const BENCHHASHER* pHasher)
+{
+    if (pHasher->Hash != NULL)
+        return PnHtCreate(Flags | PN_HT_COPY_KV, 1.0, pHasher->Hash, 1024);
+    return PnHtCreateSeeded(Flags | PN_HT_COPY_KV, 1.0, pHasher->SeededHash, PnHtRandomSeed(), 1024);
+}
+
+static void BenchRow(const char* lpstrBench, const char* lpstrTable, const char* lpstrHasher, const char* lpstrDist,
+                     size_t KeyLen, size_t nEntries, size_t nOps, double Seconds, double Bytes)
+{
+    printf("%s,%s,%s,%s,%zu,%zu,%zu,%.2f,", lpstrBench, lpstrTable, lpstrHasher, lpstrDist, KeyLen, nEntries, nOps,
+           Seconds * 1e9 / (double)nOps);
+    if (Bytes > 0.0)
+        printf("%.1f\n", Bytes / Seconds / 1e6);
+    else
+        printf("-\n");
+    return;
+}
+
+/* insert, get_hit, get_miss and remove on one table; Zipf only changes which keys get_hit looks up */
+static void BenchTableOps(uint32_t Flags, const char* lpstrTable, const BENCHHASHER* pHasher, const char* lpstrPrefix,
+                          int Zipf, size_t KeyLen, size_t nEntries)
+{
+    const char* lpstrDist = Zipf ? "zipf" : "uniform";
+    size_t nLookups = nEntries < BENCH_MAX_LOOKUPS ? nEntries : BENCH_MAX_LOOKUPS;
+    uint64_t* pIndices = (uint64_t*)malloc(nLookups * sizeof(uint64_t));
+    PNHASHTABLE Table = BenchCreate(Flags, pHasher);
+    uint64_t State = 1, Value;
+    char Key[BENCH_MAX_KEY], Name[32];
+    size_t k, Found = 0;
+    double Start;
+
+    BenchIndices(pIndices, nLookups, nEntries, Zipf, &State);
+
+    Start = BenchNow();
+    for (k = 0; k < nEntries; k++)
+    {
+        Value = k;
+        BenchKey(Key, k, KeyLen);
+        PnHtInsert(&Table, Key, KeyLen, &Value, sizeof(uint64_t));
+    }
+    snprintf(Name, sizeof(Name), "%sinsert", lpstrPrefix);
+    BenchRow(Name, lpstrTable, pHasher->lpstrName, "-", KeyLen, nEntries, nEntries, BenchNow() - Start, 0.0);
+
+    Start = BenchNow();
+    for (k = 0; k < nLookups; k++)
+    {
+        BenchKey(Key, pIndices[k], KeyLen);
+        Found += PnHtGet(&Table, Key, KeyLen) != NULL;
+    }
+    snprintf(Name, sizeof(Name), "%sget_hit", lpstrPrefix);
+    BenchRow(Name, lpstrTable, pHasher->lpstrName, lpstrDist, KeyLen, nEntries, nLookups, BenchNow() - Start, 0.0);
+
+    /* Indices past nEntries were never inserted */
+    Start = BenchNow();
+    for (k = 0; k < nLookups; k++)
+    {
+        BenchKey(Key, nEntries + pIndices[k], KeyLen);
+        Found += PnHtGet(&Table, Key, KeyLen) != NULL;
+    }
+    snprintf(Name, sizeof(Name), "%sget_miss", lpstrPrefix);
+    BenchRow(Name, lpstrTable, pHasher->lpstrName, lpstrDist, KeyLen, nEntries, nLookups, BenchNow() - Start, 0.0);
+
+    Start = BenchNow();
+    for (k = 0; k < nEntries; k++)
+    {
+        BenchKey(Key, k, KeyLen);
+        Found += PnHtRemove(&Table, Key, KeyLen);
+    }
+    snprintf(Name, sizeof(Name), "%sremove", lpstrPrefix);
+    BenchRow(Name, lpstrTable, pHasher->lpstrName, "-", KeyLen, nEntries, nEntries, BenchNow() - Start, 0.0);
+
+    if (Found != nLookups + nEntries)
+        fprintf(stderr, "pn_bench: %s/%s found %zu, expected %zu\n", lpstrTable, lpstrDist, Found, nLookups + nEntries);
+
+    PnHtDestroy(&Table);
+    free(pIndices);
+    return;
+}
+
+static void BenchResize(uint32_t Flags, const char* lpstrTable, size_t nEntries)
+{
+    PNHASHTABLE Table = BenchCreate(Flags, &g_Hashers[0]);
+    char Key[16];
+    size_t k;
+    double Start;
+
+    for (k = 0; k < nEntries; k++)
+    {
+        BenchKey(Key, k, sizeof(Key));
+        PnHtInsert(&Table, Key, sizeof(Key), &k, sizeof(size_t));
+    }
+
+    Start = BenchNow();
+    PnHtResize(&Table, Table.Cap * 2);
+    BenchRow("resize", lpstrTable, g_Hashers[0].lpstrName, "-", sizeof(Key), nEntries, 1, BenchNow() - Start, 0.0);
+
+    PnHtDestroy(&Table);
+    return;
+}
+
+static void BenchHashers()
+{
+    static const size_t KeyLens[] = { 4, 8, 16, 32, 64, 256, 4096 };
+    const size_t nBytes = (size_t)64 << 20;
+    char* pBuffer = (char*)malloc(4096 + 64);
+    volatile uint32_t Sink = 0;
+    size_t h, l, k;
+
+    for (k = 0; k < 4096 + 64; k++)
+        pBuffer[k] = s_KeyChars[k & 63];
+
+    for (h = 0; h < sizeof(g_Hashers) / sizeof(g_Hashers[0]); h++)
+    {
+        for (l = 0; l < sizeof(KeyLens) / sizeof(KeyLens[0]); l++)
+        {
+            size_t nOps = nBytes / KeyLens[l];
+            uint32_t Hash = 0;
+            double Start = BenchNow();
+
+            /* Feed each hash into the next offset so calls can't be hoisted or overlapped freely */
+            for (k = 0; k < nOps; k++)
+            {
+                const char* pKey = pBuffer + (Hash & 63);
+                Hash = g_Hashers[h].Hash != NULL ? g_Hashers[h].Hash(pKey, KeyLens[l])
+                                                 : g_Hashers[h].SeededHash(pKey, KeyLens[l], 0x5EEDULL);
+            }
+            Sink ^= Hash;
+
+            BenchRow("hash", "-", g_Hashers[h].lpstrName, "-", KeyLens[l], 0, nOps, BenchNow() - Start,
+                     (double)(nOps * KeyLens[l]));
+        }
+    }
+
+    free(pBuffer);
+    return;
+}
+
+static void BenchGetBatch(uint32_t Flags, const char* lpstrName, size_t nEntries)
+{
+    const size_t nLookups = BENCH_MAX_LOOKUPS;
+    PNHASHTABLE Table = PnHtCreate(Flags, 1.0, NULL, 1024);
+    uint64_t* pKeys = (uint64_t*)malloc(nEntries * sizeof(uint64_t));
+    const void** ppLookup = (const void**)malloc(nLookups * sizeof(void*));
+    size_t* pkSizes = (size_t*)malloc(nLookups * sizeof(size_t));
+    void** ppValues = (void**)malloc(nLookups * sizeof(void*));
+    uint64_t State = 1;
+    size_t k, Found = 0;
+    double Start, Single, Batch;
+
+    for (k = 0; k < nEntries; k++)
+    {
+        pKeys[k] = BenchRandom(&State);
+        PnHtInsert(&Table, &pKeys[k], sizeof(uint64_t), &pKeys[k], sizeof(uint64_t));
+    }
+
+    for (k = 0; k < nLookups; k++)
+    {
+        ppLookup[k] = &pKeys[BenchRandom(&State) % nEntries];
+        pkSizes[k] = sizeof(uint64_t);
+    }
+
+    Start = BenchNow();
+    for (k = 0; k < nLookups; k++)
+        Found += PnHtGet(&Table, ppLookup[k], pkSizes[k]) != NULL;
+    Single = BenchNow() - Start;
+
+    Start = BenchNow();
+    PnHtGetBatch(&Table, nLookups, ppLookup, pkSizes, ppValues);
+    Batch = BenchNow() - Start;
+
+    for (k = 0; k < nLookups; k++)
+        Found += ppValues[k] != NULL;
+    if (Found != 2 * nLookups)
+        fprintf(stderr, "pn_bench: get_batch/%s found %zu, expected %zu\n", lpstrName, Found, 2 * nLookups);
+
+    BenchRow("get_single", lpstrName, "wy", "uniform", sizeof(uint64_t), nEntries, nLookups, Single, 0.0);
+    BenchRow("get_batch", lpstrName, "wy", "uniform", sizeof(uint64_t), nEntries, nLookups, Batch, 0.0);
+
+    PnHtDestroy(&Table);
+    free(pKeys);
+    free(ppLookup);
+    free(pkSizes);
+    free(ppValues);
+    return;
+}
+
+/* Pre-sized so writes never hit the grow path, only the per-value hot path is timed */
+static void BenchSerializerBegin(PNSERIALIZERPTR pData, size_t Bytes)
+{
+    PnSerializationBegin(pData);
+    PnSerializerReserve(pData, (uint32_t)Bytes);
+    return;
+}
+
+#define BENCH_SERIALIZER(Type, CType, Write, Read, Make, Flags)                                     \
+    do {                                                                                            \
+        size_t nOps = nBytes / sizeof(CType), k;                                                    \
+        volatile CType Sink = 0;                                                                    \
+        double Start;                                                                               \
+        BenchSerializerBegin(&Data, nBytes + 64);                                                   \
+        PnSerializerSetFlags(&Data, Flags);                                                         \
+        Start = BenchNow();                                                                         \
+        for (k = 0; k < nOps; k++)                                                                  \
+            Write(&Data, (CType)(Make));                                                            \
+        BenchRow("write_" Type, "-", "-", "-", sizeof(CType), 0, nOps, BenchNow() - Start,          \
+                 (double)Data.Size);                                                                \
+        PnSerializationEnd(&Data, BENCH_FILE);                                                      \
+        PnDeserializationBegin(&Data, BENCH_FILE);                                                  \
+        PnSerializerSetFlags(&Data, Flags);                                                         \
+        Start = BenchNow();                                                                         \
+        for (k = 0; k < nOps; k++)                                                                  \
+            Sink = Read(&Data);                                                                     \
+        BenchRow("read_" Type, "-", "-", "-", sizeof(CType), 0, nOps, BenchNow() - Start,           \
+                 (double)(nOps * sizeof(CType)));                                                   \
+        PnDeserializationEnd(&Data, NULL, 0);                                                       \
+        (void)Sink;                                                                                 \
+    } while (0)
+
+static void BenchSerializer()
+{
+    const size_t nBytes = (size_t)64 << 20;
+    const size_t nChunk = 64;
+    char Chunk[64];
+    PNSERIALIZER Data;
+    volatile size_t Touched = 0;
+    size_t nOps, k;
+    double Start;
+
+    BENCH_SERIALIZER("int16", int16_t, PnWriteInt16, PnReadInt16, k, PN_SER_NONE);
+    BENCH_SERIALIZER("int32", int32_t, PnWriteInt32, PnReadInt32, k, PN_SER_NONE);
+    BENCH_SERIALIZER("int64", int64_t, PnWriteInt64, PnReadInt64, k, PN_SER_NONE);
+    BENCH_SERIALIZER("float32", float, PnWriteFloat32, PnReadFloat32, k * 0.5f, PN_SER_NONE);
+    BENCH_SERIALIZER("float64", double, PnWriteFloat64, PnReadFloat64, k * 0.5, PN_SER_NONE);
+
+    /* Small values are where varints pay off, mixed 1-3 byte encodings keep the branches honest */
+    BENCH_SERIALIZER("int32_varint", int32_t, PnWriteInt32, PnReadInt32, (k * 2654435761u) % 20000 - 10000, PN_SER_VARINT);
+    BENCH_SERIALIZER("int64_varint", int64_t, PnWriteInt64, PnReadInt64, (k * 2654435761u) % 20000 - 10000, PN_SER_VARINT);
+
+    /* One call per array instead of per element */
+    {
+        uint32_t nValues = (uint32_t)(nBytes / sizeof(double));
+        double* pValues = (double*)malloc(nBytes);
+        double* pRead;
+
+        for (k = 0; k < nValues; k++)
+            pValues[k] = k * 0.5;
+
+        BenchSerializerBegin(&Data, nBytes + 64);
+        Start = BenchNow();
+        PnWriteFloat64Array(&Data, pValues, nValues);
+        BenchRow("write_float64_array", "-", "-", "-", sizeof(double), 0, nValues, BenchNow() - Start, (double)nBytes);
+        PnSerializationEnd(&Data, BENCH_FILE);
+
+        PnDeserializationBegin(&Data, BENCH_FILE);
+        Start = BenchNow();
+        PnReadFloat64Array(&Data, &pRead, NULL);
+        BenchRow("read_float64_array", "-", "-", "-", sizeof(double), 0, nValues, BenchNow() - Start, (double)nBytes);
+        PnDeserializationEnd(&Data, (void**)&pRead, 1);
+        free(pValues);
+    }
+
+    /* Streaming includes the file writes, the buffered variants above only time the copies */
+    nOps = nBytes / sizeof(int64_t);
+    PnSerializationBeginStream(&Data, BENCH_FILE);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+        PnWriteInt64(&Data, (int64_t)k);
+    PnSerializationEnd(&Data, NULL);
+    BenchRow("write_int64_stream", "-", "-", "-", sizeof(int64_t), 0, nOps, BenchNow() - Start, (double)nBytes);
+
+    /* Packing on the way out, unpacking and checksums inside PnDeserializationBegin */
+    PnSerializationBeginStream(&Data, BENCH_FILE);
+    PnSerializerSetFlags(&Data, PN_SER_COMPRESS);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+        PnWriteInt64(&Data, (int64_t)k);
+    PnSerializationEnd(&Data, NULL);
+    BenchRow("write_int64_compressed", "-", "-", "-", sizeof(int64_t), 0, nOps, BenchNow() - Start, (double)nBytes);
+
+    Start = BenchNow();
+    PnDeserializationBegin(&Data, BENCH_FILE);
+    for (k = 0; k < nOps; k++)
+        Touched += (size_t)PnReadInt64(&Data);
+    BenchRow("read_int64_compressed", "-", "-", "-", sizeof(int64_t), 0, nOps, BenchNow() - Start, (double)nBytes);
+    PnDeserializationEnd(&Data, NULL, 0);
+
+    /* Bytes: 4 byte length prefix + payload per record, reads malloc a copy each time */
+    for (k = 0; k < nChunk; k++)
+        Chunk[k] = s_KeyChars[k & 63];
+    nOps = nBytes / (nChunk + sizeof(int32_t));
+
+    BenchSerializerBegin(&Data, nBytes + 64);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+        PnWriteBytes(&Data, Chunk, (int32_t)nChunk);
+    BenchRow("write_bytes", "-", "-", "-", nChunk, 0, nOps, BenchNow() - Start, (double)Data.Size);
+    PnSerializationEnd(&Data, BENCH_FILE);
+
+    /* Same payload starting from PN_SERIALIZER_BUFSIZE, the difference is the cost of growing */
+    PnSerializationBegin(&Data);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+        PnWriteBytes(&Data, Chunk, (int32_t)nChunk);
+    BenchRow("write_bytes_grow", "-", "-", "-", nChunk, 0, nOps, BenchNow() - Start, (double)Data.Size);
+    PnSerializationEnd(&Data, BENCH_FILE);
+
+    PnDeserializationBegin(&Data, BENCH_FILE);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+    {
+        void* pBytes;
+        PnReadBytes(&Data, &pBytes, NULL);
+        free(pBytes);
+    }
+    BenchRow("read_bytes", "-", "-", "-", nChunk, 0, nOps, BenchNow() - Start, (double)(nOps * (nChunk + 4)));
+    PnDeserializationEnd(&Data, NULL, 0);
+
+    /* Page faults on the cold mapping land inside the timed loop, the fread above does not */
+    PnDeserializationBeginMapped(&Data, BENCH_FILE);
+    Start = BenchNow();
+    for (k = 0; k < nOps; k++)
+    {
+        const void* pBytes;
+        PnReadBytesView(&Data, &pBytes, NULL);
+        Touched += *(const char*)pBytes;
+    }
+    BenchRow("read_bytes_view", "-", "-", "-", nChunk, 0, nOps, BenchNow() - Start, (double)(nOps * (nChunk + 4)));
+    PnDeserializationEnd(&Data, NULL, 0);
+
+    remove(BENCH_FILE);
+    return;
+}
+
+int main(int argc, char** argv)
+{
+    static const size_t KeyLens[] = { 8, 16, 64 };
+    size_t nMax = argc > 1 ? (size_t)strtoull(argv[1], NULL, 10) : (size_t)1000000;
+    size_t n, l, h;
+    int Zipf;
+
+    printf("bench,table,hasher,dist,key_len,entries,ops,ns_per_op,mb_per_s\n");
+
+    BenchHashers();
+    BenchSerializer();
+
+    for (n = 1000; n <= nMax; n *= 10)
+    {
+        for (Zipf = 0; Zipf < 2; Zipf++)
+        {
+            for (l = 0; l < sizeof(KeyLens) / sizeof(KeyLens[0]); l++)
+            {
+                BenchTableOps(0, "chained", &g_Hashers[0], "", Zipf, KeyLens[l], n);
+                BenchTableOps(PN_HT_OPEN_ADDRESSING, "open_addressing", &g_Hashers[0], "", Zipf, KeyLens[l], n);
+            }
+        }
+
+        for (h = 1; h < sizeof(g_Hashers) / sizeof(g_Hashers[0]); h++)
+        {
+            BenchTableOps(0, "chained", &g_Hashers[h], "hasher_", 0, 16, n);
+            BenchTableOps(PN_HT_OPEN_ADDRESSING, "open_addressing", &g_Hashers[h], "hasher_", 0, 16, n);
+        }
+
+        BenchResize(0, "chained", n);
+        BenchResize(PN_HT_OPEN_ADDRESSING, "open_addressing", n);
+        BenchGetBatch(PN_HT_COPY_KV, "chained", n);
+        BenchGetBatch(PN_HT_COPY_KV | PN_HT_OPEN_ADDRESSING, "open_addressing", n);
+    }
+
+    return 0;
+}
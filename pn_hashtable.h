@@ -1,15 +1,68 @@
 #ifndef _HASHTABLE_H_
 #define _HASHTABLE_H_
 
+/* PN_HT_THREADS needs the POSIX reader/writer locks and PN_HT_STATS clock_gettime, which strict -std=cXX
+   builds hide. This only helps when the header comes before any system header, otherwise define
+   _POSIX_C_SOURCE yourself */
+#if (defined(PN_HT_THREADS) || defined(PN_HT_STATS)) && !defined(_WIN32) && defined(__STRICT_ANSI__) && \
+    !defined(_POSIX_C_SOURCE) && !defined(_XOPEN_SOURCE)
+  #define _POSIX_C_SOURCE 200112L
+#endif
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
 #include <string.h>
+#include <time.h>
 
 #include <memory.h>
 
 #define PN_HT_INITIAL_SIZE 64
 
+/* Open addressing always keeps a free slot, so the load factor is capped at this value */
+#define PN_HT_OA_MAX_LOAD  0.875
+
+/* Number of buckets PN_HT_INCREMENTAL tables migrate on every insert, get or remove */
+#ifndef PN_HT_REHASH_STEP
+  #define PN_HT_REHASH_STEP 4
+#endif
+
+/* Default minimum load factor of new tables (see PnHtSetMinLoad), 0 disables shrinking */
+#ifndef PN_HT_MIN_LOAD
+  #define PN_HT_MIN_LOAD 0.0
+#endif
+
+/* PN_HT_STATS builds: lookups are binned by entries examined, the last bin also counts longer probes */
+#ifndef PN_HT_STATS_PROBE_BINS
+  #define PN_HT_STATS_PROBE_BINS 16
+#endif
+
+/* PN_HT_THREADS builds: number of lock stripes of a PNHTCONCURRENT table (power of two) */
+#ifndef PN_HT_LOCK_STRIPES
+  #define PN_HT_LOCK_STRIPES 64
+#endif
+
+/* PnHtGetBatch/PnHtInsertBatch: number of keys hashed and prefetched ahead of the probes */
+#ifndef PN_HT_BATCH_WINDOW
+  #define PN_HT_BATCH_WINDOW 16
+#endif
+
+/* PN_HT_SLAB: entries up to PN_HT_SLAB_MAX_BLOCK bytes are carved from chunks of PN_HT_SLAB_CHUNK_SIZE */
+#ifndef PN_HT_SLAB_CHUNK_SIZE
+  #define PN_HT_SLAB_CHUNK_SIZE (64u * 1024u)
+#endif
+#define PN_HT_SLAB_MIN_BLOCK  16u
+#define PN_HT_SLAB_MAX_BLOCK  1024u
+#define PN_HT_SLAB_CLASSES    7    /* 16, 32, ..., 1024 */
+
+/* PN_HT_COPY_KV: keys/values up to these sizes are stored inside the bucket (64 bytes by default) */
+#ifndef PN_HT_INLINE_KEY_SIZE
+  #define PN_HT_INLINE_KEY_SIZE   16
+#endif
+#ifndef PN_HT_INLINE_VALUE_SIZE
+  #define PN_HT_INLINE_VALUE_SIZE 24
+#endif
+
 
 #ifdef __cplusplus
 extern "C" {
@@ -18,7 +71,7 @@ extern "C" {
 #ifdef _MSC_VER
   #define PN_HT_ALWAYS_INLINE __declspec(always_inline)
 #elif defined(__GNUC__)
-  #define PN_HT_ALWAYS_INLINE __attribute__((always_inline)) inline
+  #define PN_HT_ALWAYS_INLINE __attribute__((always_inline))
 #else
   #define PN_HT_ALWAYS_INLINE
 #endif // _MSC_VER
@@ -38,46 +91,561 @@ extern "C" {
 #endif
 
 typedef uint32_t(pfn_Hasher)(const void* Key, size_t kSize);
+typedef uint32_t(pfn_SeededHasher)(const void* Key, size_t kSize, uint64_t Seed);
+
+/* Per-entry memory (buckets, copied keys and values); "Size" is passed back on free */
+typedef void*(pfn_HtAlloc)(void* pUser, size_t Size);
+typedef void (pfn_HtFree)(void* pUser, void* pBlock, size_t Size);
+
+typedef struct
+{
+    pfn_HtAlloc*  Alloc;
+    pfn_HtFree*   Free;
+    void*         pUser;
+} PNHTALLOCATOR;
+
+typedef struct __sPNHTSLAB  PNHTSLAB;
+typedef struct __sPNHTSLAB* PNHTSLABPTR;
 
 typedef enum
 {
     PN_HT_NONE         = 0x00,
     PN_HT_COPY_KV    	= 0x01,
     PN_HT_NO_RESIZE    = 0x02,
+    PN_HT_OPEN_ADDRESSING = 0x04, /* Flat Robin Hood slot array instead of chained buckets */
+    PN_HT_INCREMENTAL  = 0x08, /* Chained only: spread resizes over later operations */
+    PN_HT_POW2         = 0x10, /* Power-of-two capacity, mixed hash masked instead of "% Cap" */
+    PN_HT_SLAB         = 0x20, /* Buckets and copied keys/values come from a per-table slab */
+    PN_HT_IMAGE        = 0x40, /* Set by PnHtOpenImage: read-only, served from the mapped file */
 } PN_HT_FLAGS;
 
 typedef struct __sPNBUCKET  PNBUCKET;
 typedef struct __sPNBUCKET* PNBUCKETPTR;
 
+typedef struct __sPNSLOT    PNSLOT;
+typedef struct __sPNSLOT*   PNSLOTPTR;
+
+/**
+ * Counters are only maintained when PN_HT_STATS is defined (identically in every translation unit,
+ * it changes the layout of PNHASHTABLE); without it they stay 0 and cost nothing.
+**/
+typedef struct
+{
+    uint64_t      Hits;       /* PnHtGet/PnHtContains/PnHtGetBatch lookups */
+    uint64_t      Misses;
+    uint64_t      Probes[PN_HT_STATS_PROBE_BINS]; /* Lookups by number of entries examined */
+    uint64_t      Resizes;    /* PnHtResize calls that replaced the storage */
+    uint64_t      ResizeNanoseconds; /* Time spent inside those (incremental migration is not included) */
+    uint64_t      EntryBytes; /* Live bytes from the entry allocator: buckets, copied keys and values */
+    /* Filled in by PnHtGetStats in every build */
+    uint64_t      TableBytes; /* Bucket, slot and control arrays (or the mapped image) */
+    uint32_t      MaxChain;   /* Longest chain, or longest probe sequence */
+} PNHTSTATS, *PNHTSTATSPTR;
+
 typedef struct
 {
     pfn_Hasher*   Hasher;
+    pfn_SeededHasher* SeededHasher; /* Used instead of "Hasher" when set */
+    uint64_t      Seed;
+    PNHTALLOCATOR Allocator;
     size_t        Count;
     size_t        Cap;
     PNBUCKETPTR*  pBuckets;
+    PNBUCKETPTR*  pOldBuckets; /* PN_HT_INCREMENTAL: buckets still waiting to be migrated */
+    size_t        OldCap;
+    size_t        RehashIdx;   /* Next bucket of "pOldBuckets" to migrate */
+    PNSLOTPTR     pSlots; /* PN_HT_OPEN_ADDRESSING only */
+    uint8_t*      pCtrl;  /* PN_HT_OPEN_ADDRESSING only: one tag byte per slot */
     uint32_t      Flags;
     uint32_t      Collisions;
-    double        MLF; /* max load factor */
+    double        MLF; /* max load factor (Count/Cap with PN_HT_OPEN_ADDRESSING) */
     double        CLF; /* current load factor */
+    double        MinLF;  /* Count/Cap under which removals shrink the table, 0 never shrinks */
+    size_t        MinCap; /* Shrinking never goes below the capacity the table was created with */
+    const uint8_t* pImage; /* PN_HT_IMAGE only: the mapped file */
+    size_t        ImageSize;
+#ifdef PN_HT_STATS
+    PNHTSTATS     Stats;
+#endif // PN_HT_STATS
 } PNHASHTABLE,  *PNHASHTABLEPTR,
   PNHASHMAP,    *PNHASHMAPPTR,
   PNDICTIONARY, *PNDICTIONARYPTR;
 
 
+/* Out of memory gives an empty table with no storage ("Cap" 0): lookups miss and every insert is refused */
 PNHASHTABLE_API PNHASHTABLE   PnHtCreate(uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap);
 PNHASHTABLE_API void          PnHtDestroy(PNHASHTABLEPTR pTable);
-PNHASHTABLE_API void          PnHtInsert(PNHASHTABLEPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize);
+/* Returns 0 if the entry was not stored: out of memory, an image table, or a full PN_HT_NO_RESIZE table */
+PNHASHTABLE_API int           PnHtInsert(PNHASHTABLEPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize);
 PNHASHTABLE_API void*         PnHtGet(PNHASHTABLEPTR pTable, const void* Key, size_t kSize);
 PNHASHTABLE_API int           PnHtRemove(PNHASHTABLEPTR pTable, const void* Key, size_t kSize);
 PNHASHTABLE_API int           PnHtContains(PNHASHTABLEPTR pTable, const void* Key, size_t kSize);
 PNHASHTABLE_API void          PnHtResize(PNHASHTABLEPTR pTable, size_t NewSize);
+PNHASHTABLE_API void          PnHtGetStats(PNHASHTABLEPTR pTable, PNHTSTATSPTR pStats);
+PNHASHTABLE_API void          PnHtResetStats(PNHASHTABLEPTR pTable);
+
+/* Passing "Hash = NULL" to PnHtCreate selects PnHashWy with a PnHtRandomSeed() seed */
+PNHASHTABLE_API PNHASHTABLE   PnHtCreateSeeded(uint32_t Flags, double MLF, pfn_SeededHasher* Hash, uint64_t Seed, int Cap);
+PNHASHTABLE_API uint64_t      PnHtRandomSeed(void);
+/**
+ * Removals halve the table while Count/Cap is under "MinLF", leaving it between MinLF and 2*MinLF full.
+ * "MinLF" is capped at a quarter of the growth threshold so shrinking and growing never alternate.
+**/
+PNHASHTABLE_API void          PnHtSetMinLoad(PNHASHTABLEPTR pTable, double MinLF);
+/* Only valid while the table is empty */
+PNHASHTABLE_API void          PnHtSetAllocator(PNHASHTABLEPTR pTable, const PNHTALLOCATOR* pAllocator);
+PNHASHTABLE_API uint32_t      PnHashWy(const void* Key, size_t kSize, uint64_t Seed);
+PNHASHTABLE_API uint32_t      PnHashAes(const void* Key, size_t kSize, uint64_t Seed);
+
+/**
+ * Batched lookups/inserts: each window of PN_HT_BATCH_WINDOW keys is hashed and prefetched up front,
+ * so the cache misses of different keys overlap instead of being paid one after another.
+ * Only worth it once the table no longer fits in the last-level cache (pn_bench.c measures it).
+ * Missing keys get a NULL value in "pValues", PnHtInsertBatch returns how many entries were stored.
+**/
+PNHASHTABLE_API void          PnHtGetBatch(PNHASHTABLEPTR pTable, size_t nKeys, const void* const* pKeys, const size_t* pkSizes, void** pValues);
+PNHASHTABLE_API size_t        PnHtInsertBatch(PNHASHTABLEPTR pTable, size_t nKeys, const void* const* pKeys, const size_t* pkSizes,
+                                              const void* const* pValues, const size_t* pvSizes);
+
+/* Return non-zero to stop visiting */
+typedef int (pfn_HtVisit)(void* pCtx, const void* Key, size_t kSize, void* Value, size_t vSize);
+
+/* The table must not be modified while an iterator is in use */
+typedef struct
+{
+    PNHASHTABLEPTR pTable;
+    size_t         Index; /* Next bucket/slot to look at */
+    PNBUCKETPTR    pNext; /* Rest of the current chain */
+    const void*    Key;
+    size_t         kSize;
+    void*          Value;
+    size_t         vSize;
+} PNHTITER, *PNHTITERPTR;
+
+/**
+ * Iteration walks the storage in memory order (slots, or bucket array and chains), so the order
+ * of the entries is unspecified:
+ *
+ *     PNHTITER It;
+ *     for (PnHtIterBegin(&Table, &It); PnHtIterNext(&It); )
+ *         Use(It.Key, It.kSize, It.Value, It.vSize);
+**/
+/**
+ * Images: PnHtSaveImage writes a flat, pointer-free copy of the table (hashes included) and
+ * PnHtOpenImage maps it read-only, PnHtGet/PnHtContains/iteration then work on the mapping itself,
+ * with no parsing or per-entry allocation. Inserts and removes are ignored, values must not be written.
+ * "Hash" is only needed for tables built with a custom pfn_Hasher, PnHashWy/PnHashAes and the seed
+ * are restored from the image. Opening checks every offset and size against the file, a truncated or
+ * corrupt image is refused instead of read out of bounds. A failed open returns a read-only table with no
+ * storage ("pImage" NULL, "Cap" 0): lookups miss, inserts and removes are refused and PnHtDestroy is a no-op.
+**/
+PNHASHTABLE_API int           PnHtSaveImage(PNHASHTABLEPTR pTable, const char* lpstrPath);
+PNHASHTABLE_API PNHASHTABLE   PnHtOpenImage(const char* lpstrPath, pfn_Hasher* Hash);
+
+PNHASHTABLE_API void          PnHtIterBegin(PNHASHTABLEPTR pTable, PNHTITERPTR pIter);
+PNHASHTABLE_API int           PnHtIterNext(PNHTITERPTR pIter);
+/* Returns the number of entries visited */
+PNHASHTABLE_API size_t        PnHtForEach(PNHASHTABLEPTR pTable, pfn_HtVisit* Visit, void* pCtx);
+
+#ifdef PN_HT_THREADS
+/**
+ * Splits the storage into "nThreads" contiguous ranges visited concurrently ("Visit" must be
+ * thread-safe); stopping only ends the range of the thread that asked.
+**/
+PNHASHTABLE_API size_t        PnHtForEachParallel(PNHASHTABLEPTR pTable, uint32_t nThreads, pfn_HtVisit* Visit, void* pCtx);
+
+typedef struct __sPNHTLOCKS  PNHTLOCKS;
+typedef struct __sPNHTLOCKS* PNHTLOCKSPTR;
+
+/**
+ * Thread-safe chained table: buckets are split into PN_HT_LOCK_STRIPES stripes, each behind its own
+ * reader/writer lock, so lookups only wait for writers of the same stripe. Resizes move one stripe
+ * at a time while the rest keep serving. Only PN_HT_COPY_KV and PN_HT_NO_RESIZE are honoured,
+ * a custom allocator set on "Table" must be thread-safe. If PnHtcCreate runs out of memory it returns
+ * a zeroed table ("pLocks" is NULL) on which every PnHtc* call does nothing and reports 0.
+**/
+typedef struct
+{
+    PNHASHTABLE   Table;       /* Hasher, allocator, flags and MLF; Count/Collisions are kept per stripe */
+    PNBUCKETPTR*  pBuckets[2]; /* By generation parity, both alive only during a resize */
+    size_t        Cap[2];
+    uint32_t      Gen;
+    PNHTLOCKSPTR  pLocks;
+} PNHTCONCURRENT, *PNHTCONCURRENTPTR;
+
+PNHASHTABLE_API PNHTCONCURRENT PnHtcCreate(uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap);
+PNHASHTABLE_API void          PnHtcDestroy(PNHTCONCURRENTPTR pTable);
+PNHASHTABLE_API int           PnHtcInsert(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize);
+/**
+ * Copies up to "vSize" bytes of the value into "pValue" (the stored value may be gone once the lock is released).
+ * "pvSize" (may be NULL) receives the full size of the stored value, larger than "vSize" when the copy was cut short.
+**/
+PNHASHTABLE_API int           PnHtcGet(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize, void* pValue, size_t vSize, size_t* pvSize);
+PNHASHTABLE_API int           PnHtcRemove(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize);
+PNHASHTABLE_API int           PnHtcContains(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize);
+PNHASHTABLE_API size_t        PnHtcCount(PNHTCONCURRENTPTR pTable);
+PNHASHTABLE_API void          PnHtcResize(PNHTCONCURRENTPTR pTable, size_t NewSize);
+
+typedef struct __sPNHTSHARD  PNHTSHARD;
+typedef struct __sPNHTSHARD* PNHTSHARDPTR;
+
+/**
+ * Sharded front-end: "nShards" (rounded up to a power of two) independent PNHASHTABLEs, each with
+ * its own lock, MLF and resizes, picked by the top bits of the hash. Any PN_HT_* flags work.
+**/
+typedef struct
+{
+    PNHTSHARDPTR  pShards;
+    uint32_t      nShards;
+    uint32_t      ShardBits;
+    void*         pBlock; /* Unaligned allocation */
+} PNHTSHARDED, *PNHTSHARDEDPTR;
+
+/* "Cap" is the initial capacity of the whole table, split evenly between the shards.
+   Out of memory gives a table with "pShards" NULL, which every PnHts* call treats as empty */
+PNHASHTABLE_API PNHTSHARDED   PnHtsCreate(uint32_t nShards, uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap);
+PNHASHTABLE_API void          PnHtsDestroy(PNHTSHARDEDPTR pTable);
+PNHASHTABLE_API int           PnHtsInsert(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize);
+/* Copies up to "vSize" bytes of the value into "pValue" while the shard is locked, "pvSize" as in PnHtcGet */
+PNHASHTABLE_API int           PnHtsGet(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize, void* pValue, size_t vSize, size_t* pvSize);
+PNHASHTABLE_API int           PnHtsRemove(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize);
+PNHASHTABLE_API int           PnHtsContains(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize);
+PNHASHTABLE_API void          PnHtsSetMinLoad(PNHTSHARDEDPTR pTable, double MinLF);
+PNHASHTABLE_API void          PnHtsGetTotals(PNHTSHARDEDPTR pTable, size_t* pCount, uint64_t* pCollisions, size_t* pMaxShardCount);
+#endif // PN_HT_THREADS
 
 #ifdef __cplusplus
 }
 #endif // __cplusplus
 
+/* Open addressing lookups scan the control bytes of a whole group of slots at once */
+#if defined(__AVX2__)
+  #include <immintrin.h>
+  #define PN_HT_GROUP_WIDTH 32
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+  #include <emmintrin.h>
+  #define PN_HT_GROUP_WIDTH 16
+#else
+  #define PN_HT_GROUP_WIDTH 8
+#endif // __AVX2__
+
+#ifdef _MSC_VER
+  #include <intrin.h>
+#endif // _MSC_VER
+
+#if defined(__GNUC__)
+  #define PN_HT_PREFETCH(p) __builtin_prefetch((const void*)(p), 0, 3)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  #define PN_HT_PREFETCH(p) _mm_prefetch((const char*)(p), _MM_HINT_T0)
+#else
+  #define PN_HT_PREFETCH(p) ((void)(p))
+#endif // __GNUC__
+
+/* Relaxed atomic adds, so tables shared between threads (PNHTCONCURRENT, PNHTSHARDED) count correctly */
+#ifndef PN_HT_STATS
+  #define PN_HT_STAT_ADD(pTable, Field, n)  ((void)0)
+#elif defined(__GNUC__)
+  #define PN_HT_STAT_ADD(pTable, Field, n)  ((void)__atomic_fetch_add(&(pTable)->Stats.Field, (uint64_t)(n), __ATOMIC_RELAXED))
+#elif defined(_MSC_VER)
+  #define PN_HT_STAT_ADD(pTable, Field, n)  ((void)_InterlockedExchangeAdd64((volatile __int64*)&(pTable)->Stats.Field, (__int64)(n)))
+#else
+  #define PN_HT_STAT_ADD(pTable, Field, n)  ((void)((pTable)->Stats.Field += (uint64_t)(n)))
+#endif // PN_HT_STATS
+
+/* Process-wide lazy state (PnHashAes' CPU probe, PnHtRandomSeed) is reached from every thread.
+   Compare-and-swap returns the value that was there, the swap happened if that equals "Old" */
+static inline uint64_t _PnAtomic_Cas64(volatile uint64_t* p, uint64_t Old, uint64_t New)
+{
+#if defined(__GNUC__)
+    __atomic_compare_exchange_n(p, &Old, New, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+    return Old;
+#elif defined(_MSC_VER)
+    return (uint64_t)_InterlockedCompareExchange64((volatile __int64*)p, (__int64)New, (__int64)Old);
+#else
+    uint64_t Seen = *p;
+    if (Seen == Old) *p = New;
+    return Seen;
+#endif // __GNUC__
+}
+
+static inline uint64_t _PnAtomic_Inc64(volatile uint64_t* p)
+{
+#if defined(__GNUC__)
+    return __atomic_add_fetch(p, 1u, __ATOMIC_RELAXED);
+#elif defined(_MSC_VER)
+    return (uint64_t)_InterlockedIncrement64((volatile __int64*)p);
+#else
+    return ++*p;
+#endif // __GNUC__
+}
+
+/* Control bytes: PN_HT_CTRL_EMPTY, or the top 7 bits of the slot's hash */
+#define PN_HT_CTRL_EMPTY   0x80u
+#define PN_HT_TAG(Hash)    ((uint8_t)((uint32_t)(Hash) >> 25))
+
+static inline uint32_t _PnHt_Ctz32(uint32_t Mask)
+{
+#ifdef _MSC_VER
+    unsigned long Index;
+    _BitScanForward(&Index, Mask);
+    return (uint32_t)Index;
+#elif defined(__GNUC__)
+    return (uint32_t)__builtin_ctz(Mask);
+#else
+    uint32_t Index = 0;
+    while (!(Mask & 1u)) { Mask >>= 1; Index++; }
+    return Index;
+#endif // _MSC_VER
+}
+
+/* Bit k is set when control byte k of the group equals "Tag" */
+static inline uint32_t _PnGroup_Match(const uint8_t* pGroup, uint8_t Tag)
+{
+#if PN_HT_GROUP_WIDTH == 32
+    __m256i Ctrl = _mm256_loadu_si256((const __m256i*)pGroup);
+    return (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(Ctrl, _mm256_set1_epi8((char)Tag)));
+#elif PN_HT_GROUP_WIDTH == 16
+    __m128i Ctrl = _mm_loadu_si128((const __m128i*)pGroup);
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(Ctrl, _mm_set1_epi8((char)Tag)));
+#else
+    uint32_t Mask = 0, k;
+    for (k = 0; k < PN_HT_GROUP_WIDTH; k++)
+        Mask |= (uint32_t)(pGroup[k] == Tag) << k;
+    return Mask;
+#endif // PN_HT_GROUP_WIDTH
+}
+
+/* Bit k is set when slot k of the group is empty */
+static inline uint32_t _PnGroup_MatchEmpty(const uint8_t* pGroup)
+{
+#if PN_HT_GROUP_WIDTH == 32
+    return (uint32_t)_mm256_movemask_epi8(_mm256_loadu_si256((const __m256i*)pGroup));
+#elif PN_HT_GROUP_WIDTH == 16
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)pGroup));
+#else
+    uint32_t Mask = 0, k;
+    for (k = 0; k < PN_HT_GROUP_WIDTH; k++)
+        Mask |= (uint32_t)(pGroup[k] >> 7) << k;
+    return Mask;
+#endif // PN_HT_GROUP_WIDTH
+}
+
+/* Integer key hashers for PN_HT_DEFINE (MurmurHash3 finalizers) */
+static inline uint32_t PnHashU32(uint32_t Key)
+{
+    Key ^= Key >> 16;
+    Key *= 0x85EBCA6BUL;
+    Key ^= Key >> 13;
+    Key *= 0xC2B2AE35UL;
+    Key ^= Key >> 16;
+    return Key;
+}
+
+static inline uint32_t PnHashU64(uint64_t Key)
+{
+    Key ^= Key >> 33;
+    Key *= 0xFF51AFD7ED558CCDULL;
+    Key ^= Key >> 33;
+    Key *= 0xC4CEB9FE1A85EC53ULL;
+    Key ^= Key >> 33;
+    return (uint32_t)Key;
+}
+
+#define PN_HT_EQ(a, b) ((a) == (b))
+
+/**
+ * Type-specialized table for fixed-size keys, values stored by value:
+ *
+ *     PN_HT_DEFINE(IDTABLE, uint64_t, double, PnHashU64, PN_HT_EQ)
+ *
+ *     IDTABLE Table = IDTABLECreate(0);
+ *     IDTABLEInsert(&Table, 42, 1.5);
+ *     double* pValue = IDTABLEGet(&Table, 42);
+ *     IDTABLERemove(&Table, 42);
+ *     IDTABLEDestroy(&Table);
+ *
+ * Linear probing over a power-of-two slot array with the same 7-bit control bytes and group
+ * scans as PN_HT_OPEN_ADDRESSING; removal shifts the run back instead of leaving tombstones.
+ * "Hash" must mix well into the low bits, "Eq" may be a macro.
+**/
+#define PN_HT_DEFINE(Name, KeyType, ValueType, Hash, Eq)                                            \
+typedef struct                                                                                      \
+{                                                                                                   \
+    size_t      Count;                                                                              \
+    size_t      Cap;                                                                                \
+    uint8_t*    pCtrl;                                                                              \
+    KeyType*    pKeys;                                                                              \
+    ValueType*  pValues;                                                                            \
+} Name;                                                                                             \
+                                                                                                    \
+static inline size_t _##Name##Find(const Name* pTable, KeyType Key, uint32_t KeyHash)               \
+{                                                                                                   \
+    const size_t Mask = pTable->Cap - 1u;                                                           \
+    const uint8_t Tag = PN_HT_TAG(KeyHash);                                                         \
+    size_t Index = KeyHash & Mask;                                                                  \
+                                                                                                    \
+    if (pTable->Cap == 0)                                                                           \
+        return (size_t)-1;                                                                          \
+                                                                                                    \
+    for (;;)                                                                                        \
+    {                                                                                               \
+        uint32_t Empty = _PnGroup_MatchEmpty(&pTable->pCtrl[Index]);                                \
+        uint32_t Match = _PnGroup_Match(&pTable->pCtrl[Index], Tag);                                \
+        if (Empty)                                                                                  \
+            Match &= (Empty & (0u - Empty)) - 1u;                                                   \
+                                                                                                    \
+        while (Match)                                                                               \
+        {                                                                                           \
+            size_t k = (Index + _PnHt_Ctz32(Match)) & Mask;                                         \
+            if (Eq(pTable->pKeys[k], Key))                                                          \
+                return k;                                                                           \
+            Match &= Match - 1u;                                                                    \
+        }                                                                                           \
+                                                                                                    \
+        if (Empty)                                                                                  \
+            return (size_t)-1;                                                                      \
+        Index = (Index + PN_HT_GROUP_WIDTH) & Mask;                                                 \
+    }                                                                                               \
+}                                                                                                   \
+                                                                                                    \
+/* First free slot of the key's run */                                                              \
+static inline size_t _##Name##FindFree(const Name* pTable, uint32_t KeyHash)                        \
+{                                                                                                   \
+    const size_t Mask = pTable->Cap - 1u;                                                           \
+    size_t Index = KeyHash & Mask;                                                                  \
+    uint32_t Empty;                                                                                 \
+                                                                                                    \
+    while ((Empty = _PnGroup_MatchEmpty(&pTable->pCtrl[Index])) == 0)                               \
+        Index = (Index + PN_HT_GROUP_WIDTH) & Mask;                                                 \
+                                                                                                    \
+    return (Index + _PnHt_Ctz32(Empty)) & Mask;                                                     \
+}                                                                                                   \
+                                                                                                    \
+static inline void _##Name##SetCtrl(Name* pTable, size_t Index, uint8_t Ctrl)                       \
+{                                                                                                   \
+    pTable->pCtrl[Index] = Ctrl;                                                                    \
+    if (Index < PN_HT_GROUP_WIDTH)                                                                  \
+        pTable->pCtrl[pTable->Cap + Index] = Ctrl;                                                  \
+}                                                                                                   \
+                                                                                                    \
+static inline int Name##Resize(Name* pTable, size_t NewCap)                                         \
+{                                                                                                   \
+    Name Old = *pTable;                                                                             \
+    size_t Cap = PN_HT_GROUP_WIDTH, k, Index;                                                       \
+                                                                                                    \
+    while (Cap < NewCap || Cap * 7u < (pTable->Count + 1u) * 8u)                                    \
+        Cap <<= 1;                                                                                  \
+                                                                                                    \
+    pTable->pCtrl = (uint8_t*)malloc(Cap + PN_HT_GROUP_WIDTH);                                      \
+    pTable->pKeys = (KeyType*)malloc(Cap * sizeof(KeyType));                                        \
+    pTable->pValues = (ValueType*)malloc(Cap * sizeof(ValueType));                                  \
+    if (pTable->pCtrl == NULL || pTable->pKeys == NULL || pTable->pValues == NULL)                  \
+    {                                                                                               \
+        free(pTable->pCtrl);                                                                        \
+        free(pTable->pKeys);                                                                        \
+        free(pTable->pValues);                                                                      \
+        *pTable = Old;                                                                              \
+        return 0;                                                                                   \
+    }                                                                                               \
+    memset(pTable->pCtrl, PN_HT_CTRL_EMPTY, Cap + PN_HT_GROUP_WIDTH);                               \
+    pTable->Cap = Cap;                                                                              \
+                                                                                                    \
+    for (k = 0; k < Old.Cap; k++)                                                                   \
+    {                                                                                               \
+        if (Old.pCtrl[k] & PN_HT_CTRL_EMPTY)                                                        \
+            continue;                                                                               \
+                                                                                                    \
+        Index = _##Name##FindFree(pTable, Hash(Old.pKeys[k]));                                      \
+        _##Name##SetCtrl(pTable, Index, Old.pCtrl[k]);                                              \
+        pTable->pKeys[Index] = Old.pKeys[k];                                                        \
+        pTable->pValues[Index] = Old.pValues[k];                                                    \
+    }                                                                                               \
+                                                                                                    \
+    free(Old.pCtrl);                                                                                \
+    free(Old.pKeys);                                                                                \
+    free(Old.pValues);                                                                              \
+    return 1;                                                                                       \
+}                                                                                                   \
+                                                                                                    \
+static inline Name Name##Create(size_t Cap)                                                         \
+{                                                                                                   \
+    Name Table;                                                                                     \
+    memset(&Table, 0, sizeof(Table));                                                               \
+    Name##Resize(&Table, Cap);                                                                      \
+    return Table;                                                                                   \
+}                                                                                                   \
+                                                                                                    \
+static inline void Name##Destroy(Name* pTable)                                                      \
+{                                                                                                   \
+    free(pTable->pCtrl);                                                                            \
+    free(pTable->pKeys);                                                                            \
+    free(pTable->pValues);                                                                          \
+    memset(pTable, 0, sizeof(*pTable));                                                             \
+}                                                                                                   \
+                                                                                                    \
+static inline ValueType* Name##Get(const Name* pTable, KeyType Key)                                 \
+{                                                                                                   \
+    size_t Index = _##Name##Find(pTable, Key, Hash(Key));                                           \
+    return Index != (size_t)-1 ? &pTable->pValues[Index] : NULL;                                    \
+}                                                                                                   \
+                                                                                                    \
+static inline int Name##Contains(const Name* pTable, KeyType Key)                                   \
+{                                                                                                   \
+    return _##Name##Find(pTable, Key, Hash(Key)) != (size_t)-1;                                     \
+}                                                                                                   \
+                                                                                                    \
+/* Returns 0 only when growing the table failed */                                                  \
+static inline int Name##Insert(Name* pTable, KeyType Key, ValueType Value)                          \
+{                                                                                                   \
+    uint32_t KeyHash = Hash(Key);                                                                   \
+    size_t Index = _##Name##Find(pTable, Key, KeyHash);                                             \
+                                                                                                    \
+    if (Index == (size_t)-1)                                                                        \
+    {                                                                                               \
+        if ((pTable->Count + 1u) * 8u > pTable->Cap * 7u && !Name##Resize(pTable, pTable->Cap * 2u))\
+            return 0;                                                                               \
+                                                                                                    \
+        Index = _##Name##FindFree(pTable, KeyHash);                                                 \
+        _##Name##SetCtrl(pTable, Index, PN_HT_TAG(KeyHash));                                        \
+        pTable->pKeys[Index] = Key;                                                                 \
+        pTable->Count++;                                                                            \
+    }                                                                                               \
+                                                                                                    \
+    pTable->pValues[Index] = Value;                                                                 \
+    return 1;                                                                                       \
+}                                                                                                   \
+                                                                                                    \
+static inline int Name##Remove(Name* pTable, KeyType Key)                                           \
+{                                                                                                   \
+    const size_t Mask = pTable->Cap - 1u;                                                           \
+    size_t Hole = _##Name##Find(pTable, Key, Hash(Key));                                            \
+    size_t Index, Home;                                                                             \
+                                                                                                    \
+    if (Hole == (size_t)-1)                                                                         \
+        return 0;                                                                                   \
+                                                                                                    \
+    /* Knuth's Algorithm R: move back every later entry whose home is not between hole and it */   \
+    for (Index = (Hole + 1u) & Mask; !(pTable->pCtrl[Index] & PN_HT_CTRL_EMPTY); Index = (Index + 1u) & Mask)\
+    {                                                                                               \
+        Home = Hash(pTable->pKeys[Index]) & Mask;                                                   \
+        if (((Index - Home) & Mask) >= ((Index - Hole) & Mask))                                     \
+        {                                                                                           \
+            _##Name##SetCtrl(pTable, Hole, pTable->pCtrl[Index]);                                   \
+            pTable->pKeys[Hole] = pTable->pKeys[Index];                                             \
+            pTable->pValues[Hole] = pTable->pValues[Index];                                         \
+            Hole = Index;                                                                           \
+        }                                                                                           \
+    }                                                                                               \
+                                                                                                    \
+    _##Name##SetCtrl(pTable, Hole, PN_HT_CTRL_EMPTY);                                               \
+    pTable->Count--;                                                                                \
+    return 1;                                                                                       \
+}
+
+
 #ifdef PN_HASHTABLE_IMPLEMENTATION
 
+
 static PN_HT_ALWAYS_INLINE inline uint32_t _pn_default_hash_func0(const void* Key, size_t kSize)
 {
     static uint32_t Seed = /* 0x485E99EB3ULL; //*/ 0xC70F6907UL;
@@ -105,296 +673,2787 @@ static PN_HT_ALWAYS_INLINE inline uint32_t _pn_default_hash_func1(const void* Ke
 	return Hash;
 }
 
-/* Hash table pBuckets */
-struct __sPNBUCKET
+/* Seeded hashers: 8-16 bytes per step (wyhash final4 structure), folded to 32 bits */
+#define _PN_HASH_P0 0xA0761D6478BD642FULL
+#define _PN_HASH_P1 0xE7037ED1A0B428DBULL
+#define _PN_HASH_P2 0x8EBC6AF09C88C6E3ULL
+#define _PN_HASH_P3 0x589965CC75374CC3ULL
+
+#if (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))) || (defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)))
+  #define PN_HT_HAS_AESNI
+  #include <wmmintrin.h>
+  #ifdef __GNUC__
+    #define PN_HT_TARGET_AES __attribute__((target("aes,sse2")))
+  #else
+    #define PN_HT_TARGET_AES
+  #endif // __GNUC__
+#endif
+
+static PN_HT_ALWAYS_INLINE inline void _PnHash_Mum(uint64_t* pA, uint64_t* pB)
 {
-    void*       Key;
-    void*       Value;
-    uint32_t    kSize;
-    uint32_t    vSize;
-    PNBUCKETPTR pNext;
-};
+#if defined(__SIZEOF_INT128__)
+    __uint128_t r = (__uint128_t)*pA * *pB;
+    *pA = (uint64_t)r;
+    *pB = (uint64_t)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *pA = _umul128(*pA, *pB, pB);
+#else
+    uint64_t ha = *pA >> 32, hb = *pB >> 32, la = (uint32_t)*pA, lb = (uint32_t)*pB;
+    uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+    uint64_t t = rl + (rm0 << 32), c = t < rl;
+    uint64_t lo = t + (rm1 << 32);
+    c += lo < t;
+    *pA = lo;
+    *pB = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif // __SIZEOF_INT128__
+}
 
-/* HASH TABLE BUCKET FUNCTIONS */
-static PNBUCKETPTR _PnBkt_Create(uint32_t Flags, const void* Key, size_t kSize, const void* Value, size_t vSize)
+static PN_HT_ALWAYS_INLINE inline uint64_t _PnHash_Mix(uint64_t A, uint64_t B)
 {
-    PNBUCKETPTR b = (PNBUCKETPTR)malloc(sizeof(PNBUCKET));
-    if (b == NULL)
-        return NULL;
+    _PnHash_Mum(&A, &B);
+    return A ^ B;
+}
 
-    /* Set Key */
-    b->kSize = kSize;
-	b->vSize = vSize;
+static PN_HT_ALWAYS_INLINE inline uint64_t _PnHash_Read64(const uint8_t* p) { uint64_t v; memcpy(&v, p, 8); return v; }
+static PN_HT_ALWAYS_INLINE inline uint64_t _PnHash_Read32(const uint8_t* p) { uint32_t v; memcpy(&v, p, 4); return v; }
+static PN_HT_ALWAYS_INLINE inline uint64_t _PnHash_Read3(const uint8_t* p, size_t k)
+{
+    return ((uint64_t)p[0] << 16) | ((uint64_t)p[k >> 1] << 8) | p[k - 1];
+}
 
-    if (Flags & PN_HT_COPY_KV)
-    {
-		b->Key = malloc(b->kSize);
-		b->Value = malloc(b->vSize);
+uint32_t PnHashWy(const void* Key, size_t kSize, uint64_t Seed)
+{
+    const uint8_t* p = (const uint8_t*)Key;
+    size_t n = kSize;
+    uint64_t A, B;
 
-		if (b->Key == NULL || b->Value == NULL)
+    Seed ^= _PnHash_Mix(Seed ^ _PN_HASH_P0, _PN_HASH_P1);
+
+    if (n <= 16)
+    {
+        if (n >= 4)
         {
-            free(b);
-            return NULL;
+            A = (_PnHash_Read32(p) << 32) | _PnHash_Read32(p + ((n >> 3) << 2));
+            B = (_PnHash_Read32(p + n - 4) << 32) | _PnHash_Read32(p + n - 4 - ((n >> 3) << 2));
         }
-        memcpy(b->Key, Key, b->kSize);
-        memcpy(b->Value, Value, b->vSize);
-	}
+        else if (n > 0)
+        {
+            A = _PnHash_Read3(p, n);
+            B = 0;
+        }
+        else
+            A = B = 0;
+    }
     else
-	{
-		b->Key = (void*)Key;
-		b->Value = (void*)Value;
-	}
+    {
+        if (n > 48)
+        {
+            uint64_t See1 = Seed, See2 = Seed;
+            do
+            {
+                Seed = _PnHash_Mix(_PnHash_Read64(p) ^ _PN_HASH_P1, _PnHash_Read64(p + 8) ^ Seed);
+                See1 = _PnHash_Mix(_PnHash_Read64(p + 16) ^ _PN_HASH_P2, _PnHash_Read64(p + 24) ^ See1);
+                See2 = _PnHash_Mix(_PnHash_Read64(p + 32) ^ _PN_HASH_P3, _PnHash_Read64(p + 40) ^ See2);
+                p += 48;
+                n -= 48;
+            } while (n > 48);
+            Seed ^= See1 ^ See2;
+        }
 
-    b->pNext = NULL;
-    return b;
+        while (n > 16)
+        {
+            Seed = _PnHash_Mix(_PnHash_Read64(p) ^ _PN_HASH_P1, _PnHash_Read64(p + 8) ^ Seed);
+            p += 16;
+            n -= 16;
+        }
+
+        A = _PnHash_Read64(p + n - 16);
+        B = _PnHash_Read64(p + n - 8);
+    }
+
+    A ^= _PN_HASH_P1;
+    B ^= Seed;
+    _PnHash_Mum(&A, &B);
+
+    A = _PnHash_Mix(A ^ _PN_HASH_P0 ^ kSize, B ^ _PN_HASH_P1);
+    return (uint32_t)(A ^ (A >> 32));
 }
 
-static void _PnBkt_Destroy(PNBUCKETPTR pBkt, uint32_t Flags)
+#ifdef PN_HT_HAS_AESNI
+static int _PnHash_CpuHasAes(void)
 {
-    if (pBkt == NULL) return;
+#ifdef _MSC_VER
+    int Info[4];
+    __cpuid(Info, 1);
+    return (Info[2] >> 25) & 1;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("aes") != 0;
+#endif // _MSC_VER
+}
+
+/* One AES round per 16-byte block, the running sum of the blocks acts as the round key */
+PN_HT_TARGET_AES static uint32_t _PnHash_AesNi(const void* Key, size_t kSize, uint64_t Seed)
+{
+    const uint8_t* p = (const uint8_t*)Key;
+    size_t n = kSize;
+    uint8_t Tail[16];
+    uint64_t Out[2];
 
-    if (Flags & PN_HT_COPY_KV)
+    __m128i State = _mm_set_epi64x((long long)(Seed ^ _PN_HASH_P0), (long long)(Seed ^ kSize ^ _PN_HASH_P1));
+    __m128i Sum = _mm_set_epi64x((long long)_PN_HASH_P2, (long long)_PN_HASH_P3);
+    __m128i Block;
+
+    while (n > 16)
     {
-        free(pBkt->Key);
-        free(pBkt->Value);
+        Block = _mm_loadu_si128((const __m128i*)p);
+        State = _mm_aesenc_si128(_mm_xor_si128(State, Block), Sum);
+        Sum = _mm_add_epi64(Sum, Block);
+        p += 16;
+        n -= 16;
     }
 
-    pBkt->kSize = 0u;
-    pBkt->vSize = 0u;
-    free(pBkt);
-	pBkt = NULL;
+    memset(Tail, 0, sizeof(Tail));
+    memcpy(Tail, p, n);
+    Block = _mm_loadu_si128((const __m128i*)Tail);
+    State = _mm_aesenc_si128(_mm_xor_si128(State, Block), Sum);
+    Sum = _mm_add_epi64(Sum, Block);
 
-    return;
+    State = _mm_aesenc_si128(State, Sum);
+    State = _mm_aesenc_si128(State, _mm_set_epi64x((long long)_PN_HASH_P1, (long long)_PN_HASH_P0));
+
+    _mm_storeu_si128((__m128i*)Out, State);
+    return (uint32_t)(Out[0] ^ (Out[0] >> 32) ^ Out[1]);
 }
+#endif // PN_HT_HAS_AESNI
 
-static int _PnBkt_KeyCmp(PNBUCKETPTR pBkt0, PNBUCKETPTR pBkt1)
+/* Uses AES-NI when the CPU has it (checked once), PnHashWy otherwise */
+uint32_t PnHashAes(const void* Key, size_t kSize, uint64_t Seed)
 {
-    if (pBkt0->kSize != pBkt1->kSize)
-        return 0;
+#ifdef PN_HT_HAS_AESNI
+    /* 0 until probed, then 1 (no AES-NI) or 2; racing probes all store the same answer */
+    static volatile uint64_t HasAes = 0;
+    uint64_t Has = _PnAtomic_Cas64(&HasAes, 0, 0);
+
+    if (Has == 0)
+    {
+        Has = _PnHash_CpuHasAes() ? 2u : 1u;
+        _PnAtomic_Cas64(&HasAes, 0, Has);
+    }
+    if (Has == 2u)
+        return _PnHash_AesNi(Key, kSize, Seed);
+#endif // PN_HT_HAS_AESNI
 
-    char* Key0 = (char*)pBkt0->Key;
-    char* Key1 = (char*)pBkt1->Key;
+    return PnHashWy(Key, kSize, Seed);
+}
 
-    return PN_STRNCMP(Key0, Key1, pBkt0->kSize);
+static uint64_t _PnHash_SplitMix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
 }
 
-static void _PnBkt_SetValue(PNBUCKETPTR pBkt, uint32_t Flags, const void* Value, uint32_t vSize)
+/* Safe to call from any thread: the first caller to publish "Base" wins, and every call gets its own counter value */
+uint64_t PnHtRandomSeed(void)
 {
-    if (Flags & PN_HT_COPY_KV)
+    static volatile uint64_t SharedBase = 0;
+    static volatile uint64_t Counter = 0;
+    uint64_t Base = _PnAtomic_Cas64(&SharedBase, 0, 0);
+
+    if (Base == 0)
     {
-        if (pBkt->Value) free(pBkt->Value);
-        pBkt->Value = malloc(pBkt->vSize);
+        /* ASLR'd addresses and the clock, plus the OS generator where there is one */
+        uint64_t Entropy = (uint64_t)time(NULL) ^ ((uint64_t)clock() << 32) ^ (uint64_t)(uintptr_t)&Entropy;
+        uint64_t Seen;
+#if defined(__unix__) || defined(__APPLE__)
+        FILE* pFile = fopen("/dev/urandom", "rb");
+        if (pFile != NULL)
+        {
+            uint64_t Random = 0;
+            if (fread(&Random, sizeof(Random), 1, pFile) == 1)
+                Entropy ^= Random;
+            fclose(pFile);
+        }
+#endif
+        Base = _PnHash_SplitMix64(Entropy) | 1u;
 
-        if (pBkt->Value == NULL)
-			return;
-        memcpy(pBkt->Value, Value, vSize);
+        /* Lost the race: use the winner's base, so seeds never repeat between threads */
+        Seen = _PnAtomic_Cas64(&SharedBase, 0, Base);
+        if (Seen != 0) Base = Seen;
     }
-    else
-		pBkt->Value = (void*)Value;
 
-    pBkt->vSize = vSize;
-    return;
+    return _PnHash_SplitMix64(Base + 0x9E3779B97F4A7C15ULL * _PnAtomic_Inc64(&Counter));
 }
 
-
-/* HASH TABLE FUNCTIONS */
-PNHASHTABLE PnHtCreate(uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap)
+/* HASH TABLE ALLOCATOR FUNCTIONS */
+static void* _PnHt_MallocAlloc(void* pUser, size_t Size)
 {
-    PNHASHTABLE Table;
-    size_t k;
-
-    Table.Flags = Flags;
-    Table.Hasher = Hash != NULL ? Hash : &_pn_default_hash_func1;
-    Table.Count = 0;
-    Table.Cap = Cap <= 0 ? PN_HT_INITIAL_SIZE : Cap;
-    Table.Collisions = 0;
-    Table.MLF = MLF;
-    Table.CLF = 0.0d;
-    Table.pBuckets = (PNBUCKETPTR*)malloc(sizeof(PNBUCKETPTR) * Table.Cap);
-    for (k = 0; k < Table.Cap; k++)
-        Table.pBuckets[k] = NULL;
+    (void)pUser;
+    return malloc(Size);
+}
 
-    return Table;
+static void _PnHt_MallocFree(void* pUser, void* pBlock, size_t Size)
+{
+    (void)pUser;
+    (void)Size;
+    free(pBlock);
 }
 
-void PnHtDestroy(PNHASHTABLEPTR pTable)
+typedef struct __sPNHTSLABCHUNK
 {
-    size_t k;
-    for (k = 0; k < pTable->Cap; k++)
-    {
-        _PnBkt_Destroy(pTable->pBuckets[k], pTable->Flags);
-        pTable->pBuckets[k] = NULL;
-    }
+    struct __sPNHTSLABCHUNK* pNext;
+    size_t                   _Pad; /* Keeps the blocks that follow 16-byte aligned */
+} PNHTSLABCHUNK;
 
-    free(pTable->pBuckets);
-	pTable->pBuckets = NULL;
-    pTable->Flags = 0;
+/* Blocks bigger than PN_HT_SLAB_MAX_BLOCK get their own malloc, linked so they can be released in bulk */
+typedef struct __sPNHTSLABLARGE
+{
+    struct __sPNHTSLABLARGE* pPrev;
+    struct __sPNHTSLABLARGE* pNext;
+} PNHTSLABLARGE;
 
-    pTable->Hasher = NULL;
-    pTable->Count = 0;
-    pTable->Collisions = 0;
-    pTable->Cap = 0;
-    pTable->MLF = 0.0d;
-    pTable->CLF = 0.0d;
+struct __sPNHTSLAB
+{
+    void*           pFree[PN_HT_SLAB_CLASSES]; /* One free list per power-of-two size class */
+    PNHTSLABCHUNK*  pChunks;
+    PNHTSLABLARGE*  pLarge;
+    char*           pBump;
+    char*           pBumpEnd;
+};
 
-    return;
+static PN_HT_ALWAYS_INLINE inline size_t _PnSlab_Class(size_t Size)
+{
+    size_t Class = 0;
+    while (((size_t)PN_HT_SLAB_MIN_BLOCK << Class) < Size)
+        Class++;
+    return Class;
 }
 
-void PnHtInsert(PNHASHTABLEPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize)
+static void* _PnSlab_Alloc(void* pUser, size_t Size)
 {
-    PNBUCKETPTR pBucket = _PnBkt_Create(pTable->Flags, Key, kSize, Value, vSize);
-    uint32_t Index = pTable->Hasher(Key, kSize) % pTable->Cap;
-    PNBUCKETPTR tmp = pTable->pBuckets[Index];
-    int KeyIsSame = 0;
+    PNHTSLABPTR pSlab = (PNHTSLABPTR)pUser;
+    size_t Class, BlockSize, Align;
+    void* pBlock;
 
-    if (tmp == NULL)
+    if (Size > PN_HT_SLAB_MAX_BLOCK)
     {
-        pTable->pBuckets[Index] = pBucket;
-        pTable->Count++;
-        return;
-    }
+        PNHTSLABLARGE* pLarge = (PNHTSLABLARGE*)malloc(sizeof(PNHTSLABLARGE) + Size);
+        if (pLarge == NULL)
+            return NULL;
 
-    while (tmp->pNext != NULL)
-    {
-        if (_PnBkt_KeyCmp(tmp, pBucket))
-        {
-            KeyIsSame = 1;
-            break;
-        }
-        else tmp = tmp->pNext;
-    }
+        pLarge->pPrev = NULL;
+        pLarge->pNext = pSlab->pLarge;
+        if (pSlab->pLarge != NULL)
+            pSlab->pLarge->pPrev = pLarge;
+        pSlab->pLarge = pLarge;
 
-    if (KeyIsSame)
-    {
-        _PnBkt_SetValue(tmp, pTable->Flags, pBucket->Value, pBucket->vSize);
-        _PnBkt_Destroy(pBucket, pTable->Flags);
+        return pLarge + 1;
     }
-    else
+
+    Class = _PnSlab_Class(Size);
+    pBlock = pSlab->pFree[Class];
+    if (pBlock != NULL)
     {
-        tmp->pNext = pBucket;
-        pTable->Collisions += 1;
-        pTable->Count++;
-        pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+        pSlab->pFree[Class] = *(void**)pBlock;
+        return pBlock;
     }
 
-    if (pTable->CLF > pTable->MLF)
-        printf("DEBUG: CLF: %g, MLF: %g, %u\n", pTable->CLF, pTable->MLF, pTable->Flags & PN_HT_NO_RESIZE);
+    /* Blocks are aligned to their size (capped at a cache line) so a bucket never straddles two lines */
+    BlockSize = (size_t)PN_HT_SLAB_MIN_BLOCK << Class;
+    Align = BlockSize < 64u ? BlockSize : 64u;
+    pSlab->pBump = (char*)(((uintptr_t)pSlab->pBump + (Align - 1u)) & ~(uintptr_t)(Align - 1u));
 
-    if(!(pTable->Flags & PN_HT_NO_RESIZE) && (pTable->CLF > pTable->MLF))
-        PnHtResize(pTable, pTable->Cap * 2u);
+    if (pSlab->pBump > pSlab->pBumpEnd || (size_t)(pSlab->pBumpEnd - pSlab->pBump) < BlockSize)
+    {
+        PNHTSLABCHUNK* pChunk = (PNHTSLABCHUNK*)malloc(sizeof(PNHTSLABCHUNK) + PN_HT_SLAB_CHUNK_SIZE + 64u);
+        if (pChunk == NULL)
+            return NULL;
 
-    return;
+        /* The tail of the old chunk is simply abandoned, it is at most one block of waste */
+        pChunk->pNext = pSlab->pChunks;
+        pSlab->pChunks = pChunk;
+        pSlab->pBump = (char*)(((uintptr_t)(pChunk + 1) + 63u) & ~(uintptr_t)63u);
+        pSlab->pBumpEnd = pSlab->pBump + PN_HT_SLAB_CHUNK_SIZE;
+    }
+
+    pBlock = pSlab->pBump;
+    pSlab->pBump += BlockSize;
+    return pBlock;
 }
 
-void* PnHtGet(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+static void _PnSlab_Free(void* pUser, void* pBlock, size_t Size)
 {
-    uint32_t Index = pTable->Hasher(Key, kSize) % pTable->Cap;
-    PNBUCKETPTR pBucket = pTable->pBuckets[Index];
+    PNHTSLABPTR pSlab = (PNHTSLABPTR)pUser;
+    size_t Class;
 
-    PNBUCKET tmp;
-    tmp.Key = (void*)Key;
-    tmp.kSize = kSize;
+    if (pBlock == NULL)
+        return;
 
-    while (pBucket != NULL)
+    if (Size > PN_HT_SLAB_MAX_BLOCK)
     {
-        if (_PnBkt_KeyCmp(pBucket, &tmp))
-            return pBucket->Value;
+        PNHTSLABLARGE* pLarge = (PNHTSLABLARGE*)pBlock - 1;
+        if (pLarge->pPrev != NULL)
+            pLarge->pPrev->pNext = pLarge->pNext;
         else
-            pBucket = pBucket->pNext;
+            pSlab->pLarge = pLarge->pNext;
+        if (pLarge->pNext != NULL)
+            pLarge->pNext->pPrev = pLarge->pPrev;
+
+        free(pLarge);
+        return;
     }
 
-    return NULL;
+    Class = _PnSlab_Class(Size);
+    *(void**)pBlock = pSlab->pFree[Class];
+    pSlab->pFree[Class] = pBlock;
+    return;
 }
 
-int PnHtRemove(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+static PNHTSLABPTR _PnSlab_Create(void)
 {
-    uint32_t Index = pTable->Hasher(Key, kSize) % pTable->Cap;
-    PNBUCKETPTR pBucket = pTable->pBuckets[Index];
-    PNBUCKETPTR pPrev = NULL;
+    return (PNHTSLABPTR)calloc(1, sizeof(PNHTSLAB));
+}
 
-    PNBUCKET tmp;
-    tmp.Key = (void*)Key;
-    tmp.kSize = kSize;
+/* Releases every block at once, O(chunks) */
+static void _PnSlab_Destroy(PNHTSLABPTR pSlab)
+{
+    if (pSlab == NULL)
+        return;
 
-    while(pBucket != NULL)
+    while (pSlab->pChunks != NULL)
     {
-        if(_PnBkt_KeyCmp(pBucket, &tmp))
-        {
-            if(pPrev == NULL)
-                pTable->pBuckets[Index] = pBucket->pNext;
-            else
-                pPrev->pNext = pBucket->pNext;
-
-            pTable->Count--;
-
-            if(pPrev != NULL)
-              pTable->Collisions--;
+        PNHTSLABCHUNK* pNext = pSlab->pChunks->pNext;
+        free(pSlab->pChunks);
+        pSlab->pChunks = pNext;
+    }
 
-            _PnBkt_Destroy(pBucket, pTable->Flags);
-            return 1;
-        }
-        else
-        {
-            pPrev = pBucket;
-            pBucket = pBucket->pNext;
-        }
+    while (pSlab->pLarge != NULL)
+    {
+        PNHTSLABLARGE* pNext = pSlab->pLarge->pNext;
+        free(pSlab->pLarge);
+        pSlab->pLarge = pNext;
     }
 
-    return 0;
+    free(pSlab);
+    return;
 }
 
-int PnHtContains(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+static PN_HT_ALWAYS_INLINE inline void* _PnHt_Alloc(PNHASHTABLEPTR pTable, size_t Size)
 {
-    uint32_t Index = pTable->Hasher(Key, kSize) % pTable->Cap;
-    PNBUCKETPTR pBucket = pTable->pBuckets[Index];
-
-    PNBUCKET tmp;
-    tmp.Key = (void*)Key;
-    tmp.kSize = kSize;
+    void* pBlock = pTable->Allocator.Alloc(pTable->Allocator.pUser, Size);
+    if (pBlock != NULL)
+        PN_HT_STAT_ADD(pTable, EntryBytes, Size);
+    return pBlock;
+}
 
-    while (pBucket != NULL)
+static PN_HT_ALWAYS_INLINE inline void _PnHt_Free(PNHASHTABLEPTR pTable, void* pBlock, size_t Size)
+{
+    if (pBlock != NULL)
     {
-        if (_PnBkt_KeyCmp(pBucket, &tmp))
-            return 1;
-        else
-            pBucket = pBucket->pNext;
+        PN_HT_STAT_ADD(pTable, EntryBytes, (uint64_t)0 - (uint64_t)Size);
+        pTable->Allocator.Free(pTable->Allocator.pUser, pBlock, Size);
     }
+}
+
+/* Hash table pBuckets */
+struct __sPNBUCKET
+{
+    uint32_t    Hash; /* Cached so resizing never calls the hasher again */
+    uint32_t    kSize;
+    uint32_t    vSize;
+    PNBUCKETPTR pNext;
+    /* With PN_HT_COPY_KV, payloads up to the inline size live in the bucket itself */
+    union { void* Ptr; char Inline[PN_HT_INLINE_KEY_SIZE]; }   Key;
+    union { void* Ptr; char Inline[PN_HT_INLINE_VALUE_SIZE]; } Value;
+};
 
-    return 0;
+/* HASH TABLE BUCKET FUNCTIONS */
+static PN_HT_ALWAYS_INLINE inline int _PnBkt_KeyIsInline(PNHASHTABLEPTR pTable, size_t kSize)
+{
+    return (pTable->Flags & PN_HT_COPY_KV) && kSize <= PN_HT_INLINE_KEY_SIZE;
 }
 
-void PnHtResize(PNHASHTABLEPTR pTable, size_t NewSize)
+static PN_HT_ALWAYS_INLINE inline int _PnBkt_ValueIsInline(PNHASHTABLEPTR pTable, size_t vSize)
 {
-    PNHASHTABLE newtable = PnHtCreate(pTable->Flags, pTable->MLF, pTable->Hasher, NewSize);
+    return (pTable->Flags & PN_HT_COPY_KV) && vSize <= PN_HT_INLINE_VALUE_SIZE;
+}
 
-    size_t k;
-    PNBUCKETPTR pBucket = NULL;
-    PNBUCKETPTR pNext = NULL;
-    for(k = 0; k < pTable->Cap; k++)
-    {
-        pBucket = pTable->pBuckets[k];
-        while(pBucket != NULL)
+static PN_HT_ALWAYS_INLINE inline void* _PnBkt_Key(PNHASHTABLEPTR pTable, PNBUCKETPTR pBkt)
+{
+    return _PnBkt_KeyIsInline(pTable, pBkt->kSize) ? (void*)pBkt->Key.Inline : pBkt->Key.Ptr;
+}
+
+static PN_HT_ALWAYS_INLINE inline void* _PnBkt_Value(PNHASHTABLEPTR pTable, PNBUCKETPTR pBkt)
+{
+    return _PnBkt_ValueIsInline(pTable, pBkt->vSize) ? (void*)pBkt->Value.Inline : pBkt->Value.Ptr;
+}
+
+static PNBUCKETPTR _PnBkt_Create(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    PNBUCKETPTR b = (PNBUCKETPTR)_PnHt_Alloc(pTable, sizeof(PNBUCKET));
+    if (b == NULL)
+        return NULL;
+
+    /* Set Key */
+    b->kSize = kSize;
+	b->vSize = vSize;
+
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        /* Only payloads too big for the bucket need an allocation of their own */
+        if (!_PnBkt_KeyIsInline(pTable, kSize))
+            b->Key.Ptr = _PnHt_Alloc(pTable, kSize);
+        if (!_PnBkt_ValueIsInline(pTable, vSize))
+            b->Value.Ptr = _PnHt_Alloc(pTable, vSize);
+
+		if ((!_PnBkt_KeyIsInline(pTable, kSize) && b->Key.Ptr == NULL) ||
+            (!_PnBkt_ValueIsInline(pTable, vSize) && b->Value.Ptr == NULL))
+        {
+            if (!_PnBkt_KeyIsInline(pTable, kSize))
+                _PnHt_Free(pTable, b->Key.Ptr, kSize);
+            if (!_PnBkt_ValueIsInline(pTable, vSize))
+                _PnHt_Free(pTable, b->Value.Ptr, vSize);
+            _PnHt_Free(pTable, b, sizeof(PNBUCKET));
+            return NULL;
+        }
+        memcpy(_PnBkt_Key(pTable, b), Key, kSize);
+        memcpy(_PnBkt_Value(pTable, b), Value, vSize);
+	}
+    else
+	{
+		b->Key.Ptr = (void*)Key;
+		b->Value.Ptr = (void*)Value;
+	}
+
+    b->Hash = Hash;
+    b->pNext = NULL;
+    return b;
+}
+
+static void _PnBkt_Destroy(PNHASHTABLEPTR pTable, PNBUCKETPTR pBkt)
+{
+    if (pBkt == NULL) return;
+
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        if (!_PnBkt_KeyIsInline(pTable, pBkt->kSize))
+            _PnHt_Free(pTable, pBkt->Key.Ptr, pBkt->kSize);
+        if (!_PnBkt_ValueIsInline(pTable, pBkt->vSize))
+            _PnHt_Free(pTable, pBkt->Value.Ptr, pBkt->vSize);
+    }
+
+    pBkt->kSize = 0u;
+    pBkt->vSize = 0u;
+    _PnHt_Free(pTable, pBkt, sizeof(PNBUCKET));
+	pBkt = NULL;
+
+    return;
+}
+
+static int _PnBkt_KeyCmp(PNHASHTABLEPTR pTable, PNBUCKETPTR pBkt, uint32_t Hash, const void* Key, size_t kSize)
+{
+    /* Most non-matching entries are rejected on the cached hash alone */
+    if (pBkt->Hash != Hash || pBkt->kSize != kSize)
+        return 0;
+
+    return PN_STRNCMP((const char*)_PnBkt_Key(pTable, pBkt), (const char*)Key, kSize);
+}
+
+/* Returns 0 (with the old value left in place) when the copy could not be allocated */
+static int _PnBkt_SetValue(PNHASHTABLEPTR pTable, PNBUCKETPTR pBkt, const void* Value, uint32_t vSize)
+{
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        void* pOld = _PnBkt_ValueIsInline(pTable, pBkt->vSize) ? NULL : pBkt->Value.Ptr;
+
+        if (_PnBkt_ValueIsInline(pTable, vSize))
+            memmove(pBkt->Value.Inline, Value, vSize);
+        else
+        {
+            void* pValue = _PnHt_Alloc(pTable, vSize);
+            if (pValue == NULL)
+                return 0;
+
+            memcpy(pValue, Value, vSize);
+            pBkt->Value.Ptr = pValue;
+        }
+
+        _PnHt_Free(pTable, pOld, pBkt->vSize);
+    }
+    else
+		pBkt->Value.Ptr = (void*)Value;
+
+    pBkt->vSize = vSize;
+    return 1;
+}
+
+
+/* Open addressing slots (PN_HT_OPEN_ADDRESSING) */
+struct __sPNSLOT
+{
+    void*       Key;
+    void*       Value;
+    uint32_t    kSize;
+    uint32_t    vSize;
+    uint32_t    Hash;
+    uint32_t    Dist; /* Probe distance + 1 (0 means the slot is empty) */
+};
+
+/* HASH TABLE SLOT FUNCTIONS */
+static PN_HT_ALWAYS_INLINE inline uint32_t _PnHt_Hash(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+{
+    if (pTable->SeededHasher != NULL)
+        return pTable->SeededHasher(Key, kSize, pTable->Seed);
+
+    return pTable->Hasher(Key, kSize);
+}
+
+static size_t _PnHt_RoundPow2(size_t n)
+{
+    size_t Pow2 = 1;
+    while (Pow2 < n)
+        Pow2 <<= 1;
+    return Pow2;
+}
+
+static PN_HT_ALWAYS_INLINE inline size_t _PnHt_IndexCap(PNHASHTABLEPTR pTable, uint32_t Hash, size_t Cap)
+{
+    if (pTable->Flags & PN_HT_POW2)
+        return PnHashU32(Hash) & (Cap - 1u);  /* Spreads weak hashes (djb2 on short keys) across the low bits */
+
+    return Hash % Cap;
+}
+
+static PN_HT_ALWAYS_INLINE inline size_t _PnHt_Index(PNHASHTABLEPTR pTable, uint32_t Hash)
+{
+    return _PnHt_IndexCap(pTable, Hash, pTable->Cap);
+}
+
+static PN_HT_ALWAYS_INLINE inline size_t _PnHt_NextIndex(PNHASHTABLEPTR pTable, size_t Index)
+{
+    return (++Index == pTable->Cap) ? 0 : Index;
+}
+
+/* The first PN_HT_GROUP_WIDTH control bytes are mirrored past the end so groups can wrap around */
+static PN_HT_ALWAYS_INLINE inline void _PnOa_SetCtrl(PNHASHTABLEPTR pTable, size_t Index, uint8_t Ctrl)
+{
+    pTable->pCtrl[Index] = Ctrl;
+    if (Index < PN_HT_GROUP_WIDTH)
+        pTable->pCtrl[pTable->Cap + Index] = Ctrl;
+}
+
+static double _PnOa_MaxLoad(PNHASHTABLEPTR pTable)
+{
+    return (pTable->MLF > 0.0 && pTable->MLF < PN_HT_OA_MAX_LOAD) ? pTable->MLF : PN_HT_OA_MAX_LOAD;
+}
+
+static int _PnSlot_KeyCmp(PNSLOTPTR pSlot, uint32_t Hash, const void* Key, size_t kSize)
+{
+    if (pSlot->Hash != Hash || pSlot->kSize != kSize)
+        return 0;
+
+    return PN_STRNCMP((const char*)pSlot->Key, (const char*)Key, kSize);
+}
+
+static void _PnSlot_Release(PNHASHTABLEPTR pTable, PNSLOTPTR pSlot)
+{
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        _PnHt_Free(pTable, pSlot->Key, pSlot->kSize);
+        _PnHt_Free(pTable, pSlot->Value, pSlot->vSize);
+    }
+
+    memset(pSlot, 0, sizeof(PNSLOT));
+    return;
+}
+
+/* Returns 0 (with the old value left in place) when the copy could not be allocated */
+static int _PnSlot_SetValue(PNHASHTABLEPTR pTable, PNSLOTPTR pSlot, const void* Value, size_t vSize)
+{
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        void* pValue = _PnHt_Alloc(pTable, vSize);
+        if (pValue == NULL)
+            return 0;
+
+        memcpy(pValue, Value, vSize);
+        _PnHt_Free(pTable, pSlot->Value, pSlot->vSize);
+        pSlot->Value = pValue;
+    }
+    else
+        pSlot->Value = (void*)Value;
+
+    pSlot->vSize = vSize;
+    return 1;
+}
+
+static PNSLOTPTR _PnOa_Find(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    const uint8_t Tag = PN_HT_TAG(Hash);
+    size_t Index = _PnHt_Index(pTable, Hash);
+    uint32_t Dist = 0;
+
+    for (;;)
+    {
+        const uint8_t* pGroup = &pTable->pCtrl[Index];
+        uint32_t Empty = _PnGroup_MatchEmpty(pGroup);
+        uint32_t Match = _PnGroup_Match(pGroup, Tag);
+
+        /* The run ends at the first empty slot, tags past it are stale neighbours */
+        if (Empty)
+            Match &= (Empty & (0u - Empty)) - 1u;
+
+        /* Full keys are only compared on a tag hit */
+        while (Match)
+        {
+            size_t k = Index + _PnHt_Ctz32(Match);
+            if (k >= pTable->Cap)
+                k -= pTable->Cap;
+
+            if (_PnSlot_KeyCmp(&pTable->pSlots[k], Hash, Key, kSize))
+                return &pTable->pSlots[k];
+
+            Match &= Match - 1u;
+        }
+
+        if (Empty)
+            return NULL;
+
+        Dist += PN_HT_GROUP_WIDTH;
+        Index += PN_HT_GROUP_WIDTH;
+        if (Index >= pTable->Cap)
+            Index -= pTable->Cap;
+
+        /* Robin Hood invariant: once a slot sits closer to its home than we are to ours,
+           the key cannot be further along the run */
+        if (pTable->pSlots[Index == 0 ? pTable->Cap - 1 : Index - 1].Dist < Dist)
+            return NULL;
+    }
+}
+
+/* Places a slot that is known not to be in the table yet, stealing from "richer" slots on the way */
+static void _PnOa_Place(PNHASHTABLEPTR pTable, PNSLOT Slot)
+{
+    size_t Index = _PnHt_Index(pTable, Slot.Hash);
+    Slot.Dist = 1;
+
+    for (;;)
+    {
+        PNSLOTPTR pSlot = &pTable->pSlots[Index];
+
+        if (pSlot->Dist == 0)
+        {
+            *pSlot = Slot;
+            _PnOa_SetCtrl(pTable, Index, PN_HT_TAG(Slot.Hash));
+            if (Slot.Dist > 1)
+                pTable->Collisions++;
+            return;
+        }
+
+        if (pSlot->Dist < Slot.Dist)
+        {
+            PNSLOT tmp = *pSlot;
+            *pSlot = Slot;
+            _PnOa_SetCtrl(pTable, Index, PN_HT_TAG(Slot.Hash));
+
+            if (Slot.Dist > 1)
+                pTable->Collisions++;
+            if (tmp.Dist > 1)
+                pTable->Collisions--;
+
+            Slot = tmp;
+        }
+
+        Index = _PnHt_NextIndex(pTable, Index);
+        Slot.Dist++;
+    }
+}
+
+/* Returns 1 when the slot array was actually replaced */
+static int _PnOa_Resize(PNHASHTABLEPTR pTable, size_t NewSize)
+{
+    PNSLOTPTR pOldSlots = pTable->pSlots;
+    uint8_t* pOldCtrl = pTable->pCtrl;
+    size_t OldCap = pTable->Cap;
+    size_t k;
+
+    if (NewSize <= pTable->Count)
+        NewSize = pTable->Count + 1;
+    if (NewSize < PN_HT_GROUP_WIDTH)
+        NewSize = PN_HT_GROUP_WIDTH;
+    if (pTable->Flags & PN_HT_POW2)
+        NewSize = _PnHt_RoundPow2(NewSize);
+    if (NewSize == OldCap)
+        return 0;
+
+    PNSLOTPTR pNewSlots = (PNSLOTPTR)calloc(NewSize, sizeof(PNSLOT));
+    uint8_t* pNewCtrl = (uint8_t*)malloc(NewSize + PN_HT_GROUP_WIDTH);
+    if (pNewSlots == NULL || pNewCtrl == NULL)
+    {
+        free(pNewSlots);
+        free(pNewCtrl);
+        return 0;
+    }
+    memset(pNewCtrl, PN_HT_CTRL_EMPTY, NewSize + PN_HT_GROUP_WIDTH);
+
+    pTable->pSlots = pNewSlots;
+    pTable->pCtrl = pNewCtrl;
+    pTable->Cap = NewSize;
+    pTable->Collisions = 0;
+
+    /* The cached hash is reused, keys are neither rehashed nor copied */
+    for (k = 0; k < OldCap; k++)
+        if (pOldSlots[k].Dist != 0)
+            _PnOa_Place(pTable, pOldSlots[k]);
+
+    free(pOldSlots);
+    free(pOldCtrl);
+    pTable->CLF = (double)pTable->Count / (double)pTable->Cap;
+
+    return 1;
+}
+
+/* Returns 0 when the entry could not be stored */
+static int _PnOa_Insert(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    PNSLOTPTR pSlot = _PnOa_Find(pTable, Hash, Key, kSize);
+    PNSLOT Slot;
+
+    if (pSlot != NULL)
+        return _PnSlot_SetValue(pTable, pSlot, Value, vSize);
+
+    /* PN_HT_NO_RESIZE tables fill past the max load instead, but an empty slot must always remain
+       for the probes to stop on, so the last one is refused */
+    if ((double)(pTable->Count + 1) > (double)pTable->Cap * _PnOa_MaxLoad(pTable))
+    {
+        if (!(pTable->Flags & PN_HT_NO_RESIZE))
+            PnHtResize(pTable, pTable->Cap * 2u);
+        if (pTable->Count + 1 >= pTable->Cap)
+            return 0;
+    }
+
+    Slot.Hash = Hash;
+    Slot.Dist = 0;
+    Slot.kSize = kSize;
+    Slot.vSize = vSize;
+
+    if (pTable->Flags & PN_HT_COPY_KV)
+    {
+        Slot.Key = _PnHt_Alloc(pTable, kSize);
+        Slot.Value = _PnHt_Alloc(pTable, vSize);
+
+        if (Slot.Key == NULL || Slot.Value == NULL)
+        {
+            _PnHt_Free(pTable, Slot.Key, kSize);
+            _PnHt_Free(pTable, Slot.Value, vSize);
+            return 0;
+        }
+        memcpy(Slot.Key, Key, kSize);
+        memcpy(Slot.Value, Value, vSize);
+    }
+    else
+    {
+        Slot.Key = (void*)Key;
+        Slot.Value = (void*)Value;
+    }
+
+    _PnOa_Place(pTable, Slot);
+    pTable->Count++;
+    pTable->CLF = (double)pTable->Count / (double)pTable->Cap;
+
+    return 1;
+}
+
+static int _PnOa_Remove(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    PNSLOTPTR pSlot = _PnOa_Find(pTable, Hash, Key, kSize);
+    size_t Index, Next;
+
+    if (pSlot == NULL)
+        return 0;
+
+    if (pSlot->Dist > 1)
+        pTable->Collisions--;
+    _PnSlot_Release(pTable, pSlot);
+
+    /* Backward-shift deletion: pull the rest of the run one slot closer to home, no tombstones */
+    Index = (size_t)(pSlot - pTable->pSlots);
+    for (;;)
+    {
+        Next = _PnHt_NextIndex(pTable, Index);
+        if (pTable->pSlots[Next].Dist <= 1)
+            break;
+
+        pTable->pSlots[Index] = pTable->pSlots[Next];
+        _PnOa_SetCtrl(pTable, Index, pTable->pCtrl[Next]);
+        if (--pTable->pSlots[Index].Dist == 1)
+            pTable->Collisions--;
+
+        Index = Next;
+    }
+    memset(&pTable->pSlots[Index], 0, sizeof(PNSLOT));
+    _PnOa_SetCtrl(pTable, Index, PN_HT_CTRL_EMPTY);
+
+    pTable->Count--;
+    pTable->CLF = (double)pTable->Count / (double)pTable->Cap;
+
+    return 1;
+}
+
+
+/* Read-only images (PnHtSaveImage/PnHtOpenImage): flat, offsets instead of pointers */
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif // _WIN32
+
+#define PN_HT_IMAGE_MAGIC     "PNHTIMG"
+#define PN_HT_IMAGE_VERSION   1u
+#define PN_HT_IMAGE_ORDER     0x01020304u
+#define PN_HT_IMAGE_TAIL      32u  /* Mirrored control bytes, enough for every PN_HT_GROUP_WIDTH */
+
+enum { PN_HT_IMAGE_HASH_CUSTOM = 0, PN_HT_IMAGE_HASH_WY = 1, PN_HT_IMAGE_HASH_AES = 2 };
+
+typedef struct
+{
+    char        Magic[8];
+    uint32_t    ByteOrder; /* Images are native-endian, a foreign one is refused */
+    uint32_t    Version;
+    uint64_t    Cap;       /* Slots, power of two */
+    uint64_t    Count;
+    uint64_t    Seed;
+    uint32_t    HasherId;  /* PN_HT_IMAGE_HASH_* */
+    uint32_t    Reserved;
+    uint64_t    CtrlOff;   /* Cap + PN_HT_IMAGE_TAIL control bytes, same encoding as PN_HT_OPEN_ADDRESSING */
+    uint64_t    SlotsOff;
+    uint64_t    DataOff;   /* Keys and values, each 8-byte aligned */
+    uint64_t    Size;
+} PNHTIMAGEHEADER;
+
+typedef struct
+{
+    uint64_t    KeyOff;
+    uint64_t    ValueOff;
+    uint32_t    Hash;
+    uint32_t    kSize;
+    uint32_t    vSize;
+    uint32_t    Reserved;
+} PNHTIMAGESLOT;
+
+/* IMAGE FUNCTIONS */
+static PN_HT_ALWAYS_INLINE inline const uint8_t* _PnImg_Ctrl(PNHASHTABLEPTR pTable)
+{
+    return pTable->pImage + ((const PNHTIMAGEHEADER*)pTable->pImage)->CtrlOff;
+}
+
+static PN_HT_ALWAYS_INLINE inline const PNHTIMAGESLOT* _PnImg_Slots(PNHASHTABLEPTR pTable)
+{
+    return (const PNHTIMAGESLOT*)(pTable->pImage + ((const PNHTIMAGEHEADER*)pTable->pImage)->SlotsOff);
+}
+
+static const PNHTIMAGESLOT* _PnImg_Find(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    const uint8_t* pCtrl = _PnImg_Ctrl(pTable);
+    const PNHTIMAGESLOT* pSlots = _PnImg_Slots(pTable);
+    const size_t Mask = pTable->Cap - 1u;
+    const uint8_t Tag = PN_HT_TAG(Hash);
+    size_t Index = PnHashU32(Hash) & Mask;
+    uint32_t Match, Empty;
+
+    for (;;)
+    {
+        Empty = _PnGroup_MatchEmpty(&pCtrl[Index]);
+        Match = _PnGroup_Match(&pCtrl[Index], Tag);
+        if (Empty)
+            Match &= (Empty & (0u - Empty)) - 1u;
+
+        while (Match)
+        {
+            const PNHTIMAGESLOT* pSlot = &pSlots[(Index + _PnHt_Ctz32(Match)) & Mask];
+            if (pSlot->Hash == Hash && pSlot->kSize == kSize &&
+                PN_STRNCMP((const char*)(pTable->pImage + pSlot->KeyOff), (const char*)Key, kSize))
+                return pSlot;
+            Match &= Match - 1u;
+        }
+
+        if (Empty)
+            return NULL;
+        Index = (Index + PN_HT_GROUP_WIDTH) & Mask;
+    }
+}
+
+static void _PnImg_Unmap(PNHASHTABLEPTR pTable)
+{
+    if (pTable->pImage == NULL)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile((LPCVOID)pTable->pImage);
+#else
+    munmap((void*)pTable->pImage, pTable->ImageSize);
+#endif // _WIN32
+    pTable->pImage = NULL;
+    pTable->ImageSize = 0;
+    return;
+}
+
+/* HASH TABLE FUNCTIONS */
+static PNBUCKETPTR _PnHt_FindInChain(PNHASHTABLEPTR pTable, PNBUCKETPTR pBucket, uint32_t Hash, const void* Key, size_t kSize)
+{
+    while (pBucket != NULL)
+    {
+        if (_PnBkt_KeyCmp(pTable, pBucket, Hash, Key, kSize))
+            return pBucket;
+        else
+            pBucket = pBucket->pNext;
+    }
+
+    return NULL;
+}
+
+/* While an incremental rehash is running, a key can live in either bucket array */
+static PNBUCKETPTR _PnHt_FindBucket(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    PNBUCKETPTR pBucket = _PnHt_FindInChain(pTable, pTable->pBuckets[_PnHt_Index(pTable, Hash)], Hash, Key, kSize);
+
+    if (pBucket == NULL && pTable->pOldBuckets != NULL)
+        pBucket = _PnHt_FindInChain(pTable, pTable->pOldBuckets[_PnHt_IndexCap(pTable, Hash, pTable->OldCap)], Hash, Key, kSize);
+
+    return pBucket;
+}
+
+/* Returns the unlinked bucket, "*pCollision" tells whether it counted as a collision */
+static PNBUCKETPTR _PnHt_UnlinkFromChain(PNHASHTABLEPTR pTable, PNBUCKETPTR* pHead, uint32_t Hash, const void* Key, size_t kSize, int* pCollision)
+{
+    PNBUCKETPTR pBucket = *pHead;
+    PNBUCKETPTR pPrev = NULL;
+
+    while(pBucket != NULL)
+    {
+        if(_PnBkt_KeyCmp(pTable, pBucket, Hash, Key, kSize))
+        {
+            /* Every bucket but one in a chain counts as a collision */
+            *pCollision = pPrev != NULL || pBucket->pNext != NULL;
+
+            if(pPrev == NULL)
+                *pHead = pBucket->pNext;
+            else
+                pPrev->pNext = pBucket->pNext;
+
+            return pBucket;
+        }
+        else
+        {
+            pPrev = pBucket;
+            pBucket = pBucket->pNext;
+        }
+    }
+
+    return NULL;
+}
+
+static int _PnHt_RemoveFromChain(PNHASHTABLEPTR pTable, PNBUCKETPTR* pHead, uint32_t Hash, const void* Key, size_t kSize)
+{
+    int Collision;
+    PNBUCKETPTR pBucket = _PnHt_UnlinkFromChain(pTable, pHead, Hash, Key, kSize, &Collision);
+
+    if (pBucket == NULL)
+        return 0;
+
+    pTable->Collisions -= (uint32_t)Collision;
+    pTable->Count--;
+
+    _PnBkt_Destroy(pTable, pBucket);
+    return 1;
+}
+
+static void _PnHt_DestroyChains(PNHASHTABLEPTR pTable, PNBUCKETPTR* pBuckets, size_t Cap)
+{
+    PNBUCKETPTR pBucket, pNext;
+    size_t k;
+
+    /* A slab releases all of its entries at once in PnHtDestroy */
+    for (k = 0; k < Cap && !(pTable->Flags & PN_HT_SLAB); k++)
+    {
+        for (pBucket = pBuckets[k]; pBucket != NULL; pBucket = pNext)
+        {
+            pNext = pBucket->pNext;
+            _PnBkt_Destroy(pTable, pBucket);
+        }
+        pBuckets[k] = NULL;
+    }
+
+    free(pBuckets);
+    return;
+}
+
+/* Moves up to "nSteps" non-empty old buckets into the new array (like Redis' dictRehash).
+   Returns 1 when this call finished the migration */
+static int _PnHt_RehashStep(PNHASHTABLEPTR pTable, size_t nSteps)
+{
+    size_t nEmptyVisits = nSteps * 10u;
+    size_t Index;
+    PNBUCKETPTR pBucket, pNext;
+    int Done = 0;
+
+    if (pTable->pOldBuckets == NULL)
+        return 0;
+
+    while (nSteps > 0 && pTable->RehashIdx < pTable->OldCap)
+    {
+        pBucket = pTable->pOldBuckets[pTable->RehashIdx];
+        pTable->pOldBuckets[pTable->RehashIdx++] = NULL;
+
+        if (pBucket == NULL)
+        {
+            if (--nEmptyVisits == 0)
+                break;
+            continue;
+        }
+
+        for (; pBucket != NULL; pBucket = pNext)
+        {
+            pNext = pBucket->pNext;
+            if (pNext != NULL)
+                pTable->Collisions--;
+
+            Index = _PnHt_Index(pTable, pBucket->Hash);
+            if (pTable->pBuckets[Index] != NULL)
+                pTable->Collisions++;
+
+            pBucket->pNext = pTable->pBuckets[Index];
+            pTable->pBuckets[Index] = pBucket;
+        }
+        nSteps--;
+    }
+
+    if (pTable->RehashIdx >= pTable->OldCap)
+    {
+        free(pTable->pOldBuckets);
+        pTable->pOldBuckets = NULL;
+        pTable->OldCap = 0;
+        pTable->RehashIdx = 0;
+        Done = 1;
+    }
+
+    pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+    return Done;
+}
+
+/* Halves the capacity until Count/Cap is back to at least MinLF */
+static void _PnHt_Shrink(PNHASHTABLEPTR pTable)
+{
+    size_t NewCap = pTable->Cap;
+
+    if (pTable->MinLF <= 0.0 || (double)pTable->Count >= pTable->MinLF * (double)pTable->Cap)
+        return;
+    if ((pTable->Flags & PN_HT_NO_RESIZE) || pTable->pOldBuckets != NULL)
+        return;
+
+    while (NewCap / 2u >= pTable->MinCap && (double)pTable->Count < pTable->MinLF * (double)NewCap)
+        NewCap /= 2u;
+
+    if (NewCap != pTable->Cap)
+        PnHtResize(pTable, NewCap);
+
+    return;
+}
+
+/* The incremental step of every insert, lookup and removal. A removal skips its shrink while a migration
+   is pending, so the shrink is checked again as soon as the migration is over */
+static void _PnHt_Migrate(PNHASHTABLEPTR pTable)
+{
+    if (_PnHt_RehashStep(pTable, PN_HT_REHASH_STEP))
+        _PnHt_Shrink(pTable);
+    return;
+}
+
+/* Out of memory: releases whatever was allocated and hands out an empty table with no storage (Cap 0),
+   which lookups miss, inserts and removes refuse and PnHtDestroy accepts */
+static PNHASHTABLE _PnHt_CreateFailed(PNHASHTABLEPTR pTable)
+{
+    pfn_Hasher* Hasher = pTable->Hasher;
+    pfn_SeededHasher* SeededHasher = pTable->SeededHasher;
+    uint64_t Seed = pTable->Seed;
+
+    pTable->Cap = 0;
+    PnHtDestroy(pTable);
+
+    /* Keys are still hashed before anything looks at "Cap" */
+    pTable->Hasher = Hasher;
+    pTable->SeededHasher = SeededHasher;
+    pTable->Seed = Seed;
+    pTable->Allocator.Alloc = &_PnHt_MallocAlloc;
+    pTable->Allocator.Free = &_PnHt_MallocFree;
+    return *pTable;
+}
+
+PNHASHTABLE PnHtCreate(uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap)
+{
+    PNHASHTABLE Table;
+    size_t k;
+
+    Table.Flags = Flags;
+    Table.Hasher = Hash;
+    Table.SeededHasher = Hash != NULL ? NULL : &PnHashWy;
+    Table.Seed = Hash != NULL ? 0 : PnHtRandomSeed();
+    Table.Allocator.Alloc = &_PnHt_MallocAlloc;
+    Table.Allocator.Free = &_PnHt_MallocFree;
+    Table.Allocator.pUser = NULL;
+
+    if (Flags & PN_HT_SLAB)
+    {
+        Table.Allocator.pUser = _PnSlab_Create();
+        if (Table.Allocator.pUser != NULL)
+        {
+            Table.Allocator.Alloc = &_PnSlab_Alloc;
+            Table.Allocator.Free = &_PnSlab_Free;
+        }
+        else
+            Table.Flags &= ~(uint32_t)PN_HT_SLAB;
+    }
+    Table.Count = 0;
+    Table.Cap = Cap <= 0 ? PN_HT_INITIAL_SIZE : Cap;
+    if (Flags & PN_HT_POW2)
+        Table.Cap = _PnHt_RoundPow2(Table.Cap);
+    Table.Collisions = 0;
+    Table.MLF = MLF;
+    Table.CLF = 0.0d;
+    Table.MinLF = 0.0;
+    Table.MinCap = Table.Cap;
+    Table.pImage = NULL;
+    Table.ImageSize = 0;
+#ifdef PN_HT_STATS
+    memset(&Table.Stats, 0, sizeof(Table.Stats));
+#endif // PN_HT_STATS
+    Table.pBuckets = NULL;
+    Table.pOldBuckets = NULL;
+    Table.OldCap = 0;
+    Table.RehashIdx = 0;
+    Table.pSlots = NULL;
+    Table.pCtrl = NULL;
+
+    if (Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        if (Table.Cap < PN_HT_GROUP_WIDTH)
+            Table.Cap = PN_HT_GROUP_WIDTH;
+
+        Table.pSlots = (PNSLOTPTR)calloc(Table.Cap, sizeof(PNSLOT));
+        Table.pCtrl = (uint8_t*)malloc(Table.Cap + PN_HT_GROUP_WIDTH);
+        if (Table.pSlots == NULL || Table.pCtrl == NULL)
+            return _PnHt_CreateFailed(&Table);
+
+        memset(Table.pCtrl, PN_HT_CTRL_EMPTY, Table.Cap + PN_HT_GROUP_WIDTH);
+        Table.MinCap = Table.Cap;
+        PnHtSetMinLoad(&Table, PN_HT_MIN_LOAD);
+        return Table;
+    }
+
+    Table.pBuckets = (PNBUCKETPTR*)malloc(sizeof(PNBUCKETPTR) * Table.Cap);
+    if (Table.pBuckets == NULL)
+        return _PnHt_CreateFailed(&Table);
+
+    for (k = 0; k < Table.Cap; k++)
+        Table.pBuckets[k] = NULL;
+
+    PnHtSetMinLoad(&Table, PN_HT_MIN_LOAD);
+    return Table;
+}
+
+PNHASHTABLE PnHtCreateSeeded(uint32_t Flags, double MLF, pfn_SeededHasher* Hash, uint64_t Seed, int Cap)
+{
+    PNHASHTABLE Table = PnHtCreate(Flags, MLF, NULL, Cap);
+
+    Table.SeededHasher = Hash != NULL ? Hash : &PnHashWy;
+    Table.Seed = Seed;
+
+    return Table;
+}
+
+void PnHtSetMinLoad(PNHASHTABLEPTR pTable, double MinLF)
+{
+    /* The chained MLF bounds collisions, which never exceed Count, so a quarter of it is safe as well */
+    double MaxLoad = (pTable->Flags & PN_HT_OPEN_ADDRESSING) ? _PnOa_MaxLoad(pTable) : pTable->MLF;
+
+    if (MinLF < 0.0)
+        MinLF = 0.0;
+    if (MinLF > MaxLoad / 4.0)
+        MinLF = MaxLoad / 4.0;
+
+    pTable->MinLF = MinLF;
+    return;
+}
+
+void PnHtSetAllocator(PNHASHTABLEPTR pTable, const PNHTALLOCATOR* pAllocator)
+{
+    if (pTable->Count != 0 || pAllocator == NULL)
+        return;
+
+    if (pTable->Flags & PN_HT_SLAB)
+    {
+        _PnSlab_Destroy((PNHTSLABPTR)pTable->Allocator.pUser);
+        pTable->Flags &= ~(uint32_t)PN_HT_SLAB;
+    }
+
+    pTable->Allocator = *pAllocator;
+    return;
+}
+
+void PnHtDestroy(PNHASHTABLEPTR pTable)
+{
+    size_t k;
+    if (pTable->Flags & PN_HT_IMAGE)
+        _PnImg_Unmap(pTable);
+    else if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        for (k = 0; k < pTable->Cap && !(pTable->Flags & PN_HT_SLAB); k++)
+            if (pTable->pSlots[k].Dist != 0)
+                _PnSlot_Release(pTable, &pTable->pSlots[k]);
+
+        free(pTable->pSlots);
+        free(pTable->pCtrl);
+        pTable->pSlots = NULL;
+        pTable->pCtrl = NULL;
+    }
+    else
+    {
+        if (pTable->pOldBuckets != NULL)
+            _PnHt_DestroyChains(pTable, pTable->pOldBuckets, pTable->OldCap);
+
+        _PnHt_DestroyChains(pTable, pTable->pBuckets, pTable->Cap);
+        pTable->pBuckets = NULL;
+        pTable->pOldBuckets = NULL;
+        pTable->OldCap = 0;
+        pTable->RehashIdx = 0;
+    }
+    if (pTable->Flags & PN_HT_SLAB)
+        _PnSlab_Destroy((PNHTSLABPTR)pTable->Allocator.pUser);
+    pTable->Allocator.pUser = NULL;
+    pTable->Flags = 0;
+
+    pTable->Hasher = NULL;
+    pTable->SeededHasher = NULL;
+    pTable->Seed = 0;
+    pTable->Count = 0;
+    pTable->Collisions = 0;
+    pTable->Cap = 0;
+    pTable->MLF = 0.0d;
+    pTable->CLF = 0.0d;
+    pTable->MinLF = 0.0;
+    pTable->MinCap = 0;
+
+    return;
+}
+
+static int _PnHt_InsertHashed(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    if ((pTable->Flags & PN_HT_IMAGE) || pTable->Cap == 0)
+        return 0;
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+        return _PnOa_Insert(pTable, Hash, Key, kSize, Value, vSize);
+
+    _PnHt_Migrate(pTable);
+
+    size_t Index = _PnHt_Index(pTable, Hash);
+    PNBUCKETPTR pBucket = _PnHt_FindBucket(pTable, Hash, Key, kSize);
+
+    if (pBucket != NULL)
+        return _PnBkt_SetValue(pTable, pBucket, Value, vSize);
+
+    pBucket = _PnBkt_Create(pTable, Hash, Key, kSize, Value, vSize);
+    if (pBucket == NULL)
+        return 0;
+
+    if (pTable->pBuckets[Index] != NULL)
+    {
+        pTable->Collisions += 1;
+        pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+    }
+
+    pBucket->pNext = pTable->pBuckets[Index];
+    pTable->pBuckets[Index] = pBucket;
+    pTable->Count++;
+
+    if(!(pTable->Flags & PN_HT_NO_RESIZE) && (pTable->CLF > pTable->MLF) && pTable->pOldBuckets == NULL)
+        PnHtResize(pTable, pTable->Cap * 2u);
+
+    return 1;
+}
+
+static uint32_t _PnImg_ProbeLength(PNHASHTABLEPTR pTable, uint32_t Hash, const PNHTIMAGESLOT* pFound)
+{
+    const size_t Mask = pTable->Cap - 1u;
+    size_t Home = PnHashU32(Hash) & Mask, Index;
+    uint32_t nProbes = 0;
+
+    if (pFound != NULL)
+        return (uint32_t)((((size_t)(pFound - _PnImg_Slots(pTable))) - Home) & Mask) + 1u;
+
+    for (Index = Home; !(_PnImg_Ctrl(pTable)[Index] & PN_HT_CTRL_EMPTY); Index = (Index + 1u) & Mask)
+        nProbes++;
+    return nProbes;
+}
+
+#ifdef PN_HT_STATS
+/* Probe lengths are measured after the lookup by walking the same (now cached) entries again */
+static uint32_t _PnHt_ChainProbeLength(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    uint32_t nProbes = 0;
+    PNBUCKETPTR pBucket;
+
+    for (pBucket = pTable->pBuckets[_PnHt_Index(pTable, Hash)]; pBucket != NULL; pBucket = pBucket->pNext)
+        if (++nProbes, _PnBkt_KeyCmp(pTable, pBucket, Hash, Key, kSize))
+            return nProbes;
+
+    if (pTable->pOldBuckets != NULL)
+        for (pBucket = pTable->pOldBuckets[_PnHt_IndexCap(pTable, Hash, pTable->OldCap)]; pBucket != NULL; pBucket = pBucket->pNext)
+            if (++nProbes, _PnBkt_KeyCmp(pTable, pBucket, Hash, Key, kSize))
+                return nProbes;
+
+    return nProbes;
+}
+
+/* A hit looks at "Dist" slots, a miss stops at the first slot closer to its home than the key would be */
+static uint32_t _PnOa_ProbeLength(PNHASHTABLEPTR pTable, uint32_t Hash, PNSLOTPTR pFound)
+{
+    size_t Index = _PnHt_Index(pTable, Hash);
+    uint32_t Dist = 1;
+
+    if (pFound != NULL)
+        return pFound->Dist;
+
+    while (pTable->pSlots[Index].Dist >= Dist)
+    {
+        Index = _PnHt_NextIndex(pTable, Index);
+        Dist++;
+    }
+    return Dist - 1u;
+}
+
+static void _PnHt_StatLookup(PNHASHTABLEPTR pTable, uint32_t nProbes, int Found)
+{
+    if (Found)
+        PN_HT_STAT_ADD(pTable, Hits, 1);
+    else
+        PN_HT_STAT_ADD(pTable, Misses, 1);
+
+    PN_HT_STAT_ADD(pTable, Probes[nProbes < PN_HT_STATS_PROBE_BINS ? nProbes : PN_HT_STATS_PROBE_BINS - 1u], 1);
+    return;
+}
+#endif // PN_HT_STATS
+
+/* "pvSize" may be NULL */
+static int _PnHt_LookupHashed(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize, void** ppValue, size_t* pvSize)
+{
+    /* A failed PnHtCreate/PnHtOpenImage leaves the table without any storage */
+    if (pTable->Cap == 0)
+    {
+        *ppValue = NULL;
+        if (pvSize != NULL)
+            *pvSize = 0;
+        return 0;
+    }
+
+    if (pTable->Flags & PN_HT_IMAGE)
+    {
+        const PNHTIMAGESLOT* pSlot = _PnImg_Find(pTable, Hash, Key, kSize);
+#ifdef PN_HT_STATS
+        _PnHt_StatLookup(pTable, _PnImg_ProbeLength(pTable, Hash, pSlot), pSlot != NULL);
+#endif // PN_HT_STATS
+        *ppValue = pSlot != NULL ? (void*)(pTable->pImage + pSlot->ValueOff) : NULL;
+        if (pvSize != NULL)
+            *pvSize = pSlot != NULL ? pSlot->vSize : 0;
+        return pSlot != NULL;
+    }
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        PNSLOTPTR pSlot = _PnOa_Find(pTable, Hash, Key, kSize);
+#ifdef PN_HT_STATS
+        _PnHt_StatLookup(pTable, _PnOa_ProbeLength(pTable, Hash, pSlot), pSlot != NULL);
+#endif // PN_HT_STATS
+        *ppValue = pSlot != NULL ? pSlot->Value : NULL;
+        if (pvSize != NULL)
+            *pvSize = pSlot != NULL ? pSlot->vSize : 0;
+        return pSlot != NULL;
+    }
+
+    _PnHt_Migrate(pTable);
+
+    PNBUCKETPTR pBucket = _PnHt_FindBucket(pTable, Hash, Key, kSize);
+#ifdef PN_HT_STATS
+    _PnHt_StatLookup(pTable, _PnHt_ChainProbeLength(pTable, Hash, Key, kSize), pBucket != NULL);
+#endif // PN_HT_STATS
+    *ppValue = pBucket != NULL ? _PnBkt_Value(pTable, pBucket) : NULL;
+    if (pvSize != NULL)
+        *pvSize = pBucket != NULL ? pBucket->vSize : 0;
+    return pBucket != NULL;
+}
+
+static int _PnHt_RemoveHashed(PNHASHTABLEPTR pTable, uint32_t Hash, const void* Key, size_t kSize)
+{
+    if ((pTable->Flags & PN_HT_IMAGE) || pTable->Cap == 0)
+        return 0;
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        if (!_PnOa_Remove(pTable, Hash, Key, kSize))
+            return 0;
+
+        _PnHt_Shrink(pTable);
+        return 1;
+    }
+
+    _PnHt_Migrate(pTable);
+
+    int Removed = _PnHt_RemoveFromChain(pTable, &pTable->pBuckets[_PnHt_Index(pTable, Hash)], Hash, Key, kSize);
+
+    if (!Removed && pTable->pOldBuckets != NULL)
+        Removed = _PnHt_RemoveFromChain(pTable, &pTable->pOldBuckets[_PnHt_IndexCap(pTable, Hash, pTable->OldCap)], Hash, Key, kSize);
+
+    if (Removed)
+    {
+        pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+        _PnHt_Shrink(pTable);
+    }
+
+    return Removed;
+}
+
+int PnHtInsert(PNHASHTABLEPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    return _PnHt_InsertHashed(pTable, _PnHt_Hash(pTable, Key, kSize), Key, kSize, Value, vSize);
+}
+
+void* PnHtGet(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+{
+    void* Value;
+    _PnHt_LookupHashed(pTable, _PnHt_Hash(pTable, Key, kSize), Key, kSize, &Value, NULL);
+    return Value;
+}
+
+int PnHtRemove(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+{
+    return _PnHt_RemoveHashed(pTable, _PnHt_Hash(pTable, Key, kSize), Key, kSize);
+}
+
+int PnHtContains(PNHASHTABLEPTR pTable, const void* Key, size_t kSize)
+{
+    void* Value;
+    return _PnHt_LookupHashed(pTable, _PnHt_Hash(pTable, Key, kSize), Key, kSize, &Value, NULL);
+}
+
+/* Touches the memory the lookup of "Hash" will start at */
+static PN_HT_ALWAYS_INLINE inline void _PnHt_PrefetchHome(PNHASHTABLEPTR pTable, uint32_t Hash)
+{
+    size_t Index;
+
+    if (pTable->Cap == 0)
+        return;
+
+    Index = _PnHt_Index(pTable, Hash);
+    if (pTable->Flags & PN_HT_IMAGE)
+    {
+        Index = PnHashU32(Hash) & (pTable->Cap - 1u);
+        PN_HT_PREFETCH(&_PnImg_Ctrl(pTable)[Index]);
+        PN_HT_PREFETCH(&_PnImg_Slots(pTable)[Index]);
+    }
+    else if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        PN_HT_PREFETCH(&pTable->pCtrl[Index]);
+        PN_HT_PREFETCH(&pTable->pSlots[Index]);
+    }
+    else
+        PN_HT_PREFETCH(&pTable->pBuckets[Index]);
+}
+
+/* Chained tables: once the bucket array line has arrived, fetch the first bucket of the chain */
+static PN_HT_ALWAYS_INLINE inline void _PnHt_PrefetchChain(PNHASHTABLEPTR pTable, uint32_t Hash)
+{
+    if (!(pTable->Flags & (PN_HT_OPEN_ADDRESSING | PN_HT_IMAGE)) && pTable->Cap != 0)
+    {
+        PNBUCKETPTR pBucket = pTable->pBuckets[_PnHt_Index(pTable, Hash)];
+        if (pBucket != NULL)
+            PN_HT_PREFETCH(pBucket);
+    }
+}
+
+void PnHtGetBatch(PNHASHTABLEPTR pTable, size_t nKeys, const void* const* pKeys, const size_t* pkSizes, void** pValues)
+{
+    uint32_t Hashes[PN_HT_BATCH_WINDOW];
+    size_t Base, n, k;
+
+    for (Base = 0; Base < nKeys; Base += n)
+    {
+        n = nKeys - Base < PN_HT_BATCH_WINDOW ? nKeys - Base : PN_HT_BATCH_WINDOW;
+
+        /* Hash the whole window first so all of its cache misses are in flight together */
+        for (k = 0; k < n; k++)
+        {
+            Hashes[k] = _PnHt_Hash(pTable, pKeys[Base + k], pkSizes[Base + k]);
+            _PnHt_PrefetchHome(pTable, Hashes[k]);
+        }
+
+        for (k = 0; k < n; k++)
+            _PnHt_PrefetchChain(pTable, Hashes[k]);
+
+        for (k = 0; k < n; k++)
+            _PnHt_LookupHashed(pTable, Hashes[k], pKeys[Base + k], pkSizes[Base + k], &pValues[Base + k], NULL);
+    }
+
+    return;
+}
+
+size_t PnHtInsertBatch(PNHASHTABLEPTR pTable, size_t nKeys, const void* const* pKeys, const size_t* pkSizes,
+                       const void* const* pValues, const size_t* pvSizes)
+{
+    uint32_t Hashes[PN_HT_BATCH_WINDOW];
+    size_t Base, n, k, nStored = 0;
+
+    for (Base = 0; Base < nKeys; Base += n)
+    {
+        n = nKeys - Base < PN_HT_BATCH_WINDOW ? nKeys - Base : PN_HT_BATCH_WINDOW;
+
+        for (k = 0; k < n; k++)
+        {
+            Hashes[k] = _PnHt_Hash(pTable, pKeys[Base + k], pkSizes[Base + k]);
+            _PnHt_PrefetchHome(pTable, Hashes[k]);
+        }
+
+        for (k = 0; k < n; k++)
+            _PnHt_PrefetchChain(pTable, Hashes[k]);
+
+        /* A resize halfway through the window only makes the remaining prefetches useless */
+        for (k = 0; k < n; k++)
+            nStored += (size_t)_PnHt_InsertHashed(pTable, Hashes[k], pKeys[Base + k], pkSizes[Base + k], pValues[Base + k], pvSizes[Base + k]);
+    }
+
+    return nStored;
+}
+
+/* Returns 1 when the bucket or slot array was actually replaced */
+static int _PnHt_Resize(PNHASHTABLEPTR pTable, size_t NewSize)
+{
+    if (pTable->Flags & PN_HT_IMAGE)
+        return 0;
+
+    if (pTable->Flags & PN_HT_POW2)
+        NewSize = _PnHt_RoundPow2(NewSize);
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+        return _PnOa_Resize(pTable, NewSize);
+
+    if (NewSize == 0 || NewSize == pTable->Cap)
+        return 0;
+
+    /* A pending migration has to finish before the next one can start */
+    if (pTable->pOldBuckets != NULL)
+        _PnHt_RehashStep(pTable, (size_t)-1);
+
+    if (pTable->Flags & PN_HT_INCREMENTAL)
+    {
+        PNBUCKETPTR* pNewBuckets = (PNBUCKETPTR*)calloc(NewSize, sizeof(PNBUCKETPTR));
+        if (pNewBuckets == NULL)
+            return 0;
+
+        pTable->pOldBuckets = pTable->pBuckets;
+        pTable->OldCap = pTable->Cap;
+        pTable->RehashIdx = 0;
+        pTable->pBuckets = pNewBuckets;
+        pTable->Cap = NewSize;
+        pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+        return 1;
+    }
+
+    PNBUCKETPTR* pOldBuckets = pTable->pBuckets;
+    size_t OldCap = pTable->Cap;
+    PNBUCKETPTR* pNewBuckets = (PNBUCKETPTR*)calloc(NewSize, sizeof(PNBUCKETPTR));
+    if (pNewBuckets == NULL)
+        return 0;
+
+    pTable->pBuckets = pNewBuckets;
+    pTable->Cap = NewSize;
+    pTable->Collisions = 0;
+
+    /* Existing buckets are relinked by their cached hash: no hashing, allocation or copying */
+    size_t k, Index;
+    PNBUCKETPTR pBucket = NULL;
+    PNBUCKETPTR pNext = NULL;
+    for(k = 0; k < OldCap; k++)
+    {
+        pBucket = pOldBuckets[k];
+        while(pBucket != NULL)
+        {
+            pNext = pBucket->pNext;
+            Index = _PnHt_Index(pTable, pBucket->Hash);
+
+            if (pNewBuckets[Index] != NULL)
+                pTable->Collisions++;
+
+            pBucket->pNext = pNewBuckets[Index];
+            pNewBuckets[Index] = pBucket;
+            pBucket = pNext;
+        }
+    }
+
+    free(pOldBuckets);
+    pTable->CLF = (double)pTable->Collisions / (double)pTable->Cap;
+
+    return 1;
+}
+
+#ifdef PN_HT_STATS
+/* Monotonic clock: durations must not jump with wall-clock adjustments */
+static uint64_t _PnHt_Nanoseconds(void)
+{
+#ifdef _WIN32
+    LARGE_INTEGER Now, Frequency;
+    QueryPerformanceCounter(&Now);
+    QueryPerformanceFrequency(&Frequency);
+
+    /* Whole seconds and the remainder apart, so the tick count is never multiplied past 64 bits */
+    return (uint64_t)(Now.QuadPart / Frequency.QuadPart) * 1000000000u +
+           (uint64_t)(Now.QuadPart % Frequency.QuadPart) * 1000000000u / (uint64_t)Frequency.QuadPart;
+#else
+    struct timespec Now;
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (uint64_t)Now.tv_sec * 1000000000u + (uint64_t)Now.tv_nsec;
+#endif // _WIN32
+}
+#endif // PN_HT_STATS
+
+void PnHtResize(PNHASHTABLEPTR pTable, size_t NewSize)
+{
+#ifdef PN_HT_STATS
+    /* Only resizes that replaced the storage are counted, through the same atomic adds as the other counters */
+    uint64_t Start = _PnHt_Nanoseconds();
+    if (_PnHt_Resize(pTable, NewSize))
+    {
+        PN_HT_STAT_ADD(pTable, Resizes, 1);
+        PN_HT_STAT_ADD(pTable, ResizeNanoseconds, _PnHt_Nanoseconds() - Start);
+    }
+#else
+    _PnHt_Resize(pTable, NewSize);
+#endif // PN_HT_STATS
+    return;
+}
+
+/* HASH TABLE ITERATION FUNCTIONS */
+
+/* Chained tables number the buckets of "pOldBuckets" after the "Cap" current ones */
+static size_t _PnHt_VisitSpace(PNHASHTABLEPTR pTable)
+{
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+        return pTable->Cap;
+
+    return pTable->Cap + (pTable->pOldBuckets != NULL ? pTable->OldCap : 0);
+}
+
+static PN_HT_ALWAYS_INLINE inline PNBUCKETPTR _PnHt_VisitHead(PNHASHTABLEPTR pTable, size_t Index)
+{
+    return Index < pTable->Cap ? pTable->pBuckets[Index] : pTable->pOldBuckets[Index - pTable->Cap];
+}
+
+static size_t _PnHt_VisitRange(PNHASHTABLEPTR pTable, size_t Start, size_t End, pfn_HtVisit* Visit, void* pCtx)
+{
+    const size_t Ahead = 8;
+    size_t k, nVisited = 0;
+    PNBUCKETPTR pBucket;
+    PNSLOTPTR pSlot;
+
+    if (pTable->Flags & PN_HT_IMAGE)
+    {
+        /* A failed open has nothing mapped, and no slots to visit either */
+        const uint8_t* pCtrl = pTable->pImage != NULL ? _PnImg_Ctrl(pTable) : NULL;
+        const PNHTIMAGESLOT* pImgSlot;
+
+        for (k = Start; k < End; k++)
+        {
+            if (pCtrl[k] & PN_HT_CTRL_EMPTY)
+                continue;
+
+            pImgSlot = &_PnImg_Slots(pTable)[k];
+            nVisited++;
+            if (Visit(pCtx, pTable->pImage + pImgSlot->KeyOff, pImgSlot->kSize, (void*)(pTable->pImage + pImgSlot->ValueOff), pImgSlot->vSize))
+                break;
+        }
+        return nVisited;
+    }
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        /* Slots are visited in memory order, the hardware prefetcher keeps up on its own */
+        for (k = Start; k < End; k++)
+        {
+            pSlot = &pTable->pSlots[k];
+            if (pSlot->Dist == 0)
+                continue;
+
+            nVisited++;
+            if (Visit(pCtx, pSlot->Key, pSlot->kSize, pSlot->Value, pSlot->vSize))
+                break;
+        }
+        return nVisited;
+    }
+
+    for (k = Start; k < End; k++)
+    {
+        /* The bucket array is sequential but the chains are not: fetch the heads a few buckets early */
+        if (k + Ahead < End && (pBucket = _PnHt_VisitHead(pTable, k + Ahead)) != NULL)
+            PN_HT_PREFETCH(pBucket);
+
+        for (pBucket = _PnHt_VisitHead(pTable, k); pBucket != NULL; pBucket = pBucket->pNext)
+        {
+            nVisited++;
+            if (Visit(pCtx, _PnBkt_Key(pTable, pBucket), pBucket->kSize, _PnBkt_Value(pTable, pBucket), pBucket->vSize))
+                return nVisited;
+        }
+    }
+
+    return nVisited;
+}
+
+void PnHtIterBegin(PNHASHTABLEPTR pTable, PNHTITERPTR pIter)
+{
+    pIter->pTable = pTable;
+    pIter->Index = 0;
+    pIter->pNext = NULL;
+    pIter->Key = NULL;
+    pIter->kSize = 0;
+    pIter->Value = NULL;
+    pIter->vSize = 0;
+    return;
+}
+
+int PnHtIterNext(PNHTITERPTR pIter)
+{
+    PNHASHTABLEPTR pTable = pIter->pTable;
+    size_t Space = _PnHt_VisitSpace(pTable);
+    PNBUCKETPTR pBucket;
+    PNSLOTPTR pSlot;
+
+    if (pTable->Flags & PN_HT_IMAGE)
+    {
+        while (pIter->Index < Space)
+        {
+            const PNHTIMAGESLOT* pImgSlot = &_PnImg_Slots(pTable)[pIter->Index];
+            if (_PnImg_Ctrl(pTable)[pIter->Index++] & PN_HT_CTRL_EMPTY)
+                continue;
+
+            pIter->Key = pTable->pImage + pImgSlot->KeyOff;
+            pIter->kSize = pImgSlot->kSize;
+            pIter->Value = (void*)(pTable->pImage + pImgSlot->ValueOff);
+            pIter->vSize = pImgSlot->vSize;
+            return 1;
+        }
+        return 0;
+    }
+
+    if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        while (pIter->Index < Space)
+        {
+            pSlot = &pTable->pSlots[pIter->Index++];
+            if (pSlot->Dist == 0)
+                continue;
+
+            pIter->Key = pSlot->Key;
+            pIter->kSize = pSlot->kSize;
+            pIter->Value = pSlot->Value;
+            pIter->vSize = pSlot->vSize;
+            return 1;
+        }
+        return 0;
+    }
+
+    while (pIter->pNext == NULL)
+    {
+        if (pIter->Index >= Space)
+            return 0;
+        pIter->pNext = _PnHt_VisitHead(pTable, pIter->Index++);
+    }
+
+    pBucket = pIter->pNext;
+    pIter->pNext = pBucket->pNext;
+    pIter->Key = _PnBkt_Key(pTable, pBucket);
+    pIter->kSize = pBucket->kSize;
+    pIter->Value = _PnBkt_Value(pTable, pBucket);
+    pIter->vSize = pBucket->vSize;
+    return 1;
+}
+
+size_t PnHtForEach(PNHASHTABLEPTR pTable, pfn_HtVisit* Visit, void* pCtx)
+{
+    return _PnHt_VisitRange(pTable, 0, _PnHt_VisitSpace(pTable), Visit, pCtx);
+}
+
+void PnHtGetStats(PNHASHTABLEPTR pTable, PNHTSTATSPTR pStats)
+{
+    size_t k, Length;
+    PNBUCKETPTR pBucket;
+
+#ifdef PN_HT_STATS
+    *pStats = pTable->Stats;
+#else
+    memset(pStats, 0, sizeof(*pStats));
+#endif // PN_HT_STATS
+    pStats->MaxChain = 0;
+    pStats->TableBytes = 0;
+
+    /* The structural part is measured now rather than tracked on every operation */
+    if (pTable->Flags & PN_HT_IMAGE)
+    {
+        const uint8_t* pCtrl = pTable->pImage != NULL ? _PnImg_Ctrl(pTable) : NULL;
+        for (k = 0; k < pTable->Cap; k++)
+        {
+            if (pCtrl[k] & PN_HT_CTRL_EMPTY)
+                continue;
+            Length = _PnImg_ProbeLength(pTable, _PnImg_Slots(pTable)[k].Hash, &_PnImg_Slots(pTable)[k]);
+            if (Length > pStats->MaxChain)
+                pStats->MaxChain = (uint32_t)Length;
+        }
+        pStats->TableBytes = pTable->ImageSize;
+    }
+    else if (pTable->Flags & PN_HT_OPEN_ADDRESSING)
+    {
+        for (k = 0; k < pTable->Cap; k++)
+            if (pTable->pSlots[k].Dist > pStats->MaxChain)
+                pStats->MaxChain = pTable->pSlots[k].Dist;
+        pStats->TableBytes = pTable->Cap * (sizeof(PNSLOT) + 1u) + PN_HT_GROUP_WIDTH;
+    }
+    else
+    {
+        for (k = 0; k < _PnHt_VisitSpace(pTable); k++)
+        {
+            for (Length = 0, pBucket = _PnHt_VisitHead(pTable, k); pBucket != NULL; pBucket = pBucket->pNext)
+                Length++;
+            if (Length > pStats->MaxChain)
+                pStats->MaxChain = (uint32_t)Length;
+        }
+        pStats->TableBytes = _PnHt_VisitSpace(pTable) * sizeof(PNBUCKETPTR);
+    }
+
+    return;
+}
+
+void PnHtResetStats(PNHASHTABLEPTR pTable)
+{
+#ifdef PN_HT_STATS
+    /* The allocation counter describes live memory, it is not reset */
+    uint64_t EntryBytes = pTable->Stats.EntryBytes;
+    memset(&pTable->Stats, 0, sizeof(pTable->Stats));
+    pTable->Stats.EntryBytes = EntryBytes;
+#else
+    (void)pTable;
+#endif // PN_HT_STATS
+    return;
+}
+
+/* HASH TABLE IMAGE FUNCTIONS */
+static int _PnImg_HasherId(PNHASHTABLEPTR pTable)
+{
+    if (pTable->SeededHasher == &PnHashWy)
+        return PN_HT_IMAGE_HASH_WY;
+
+    /* Without AES-NI PnHashAes falls back to PnHashWy, so that is what the image has to record */
+    if (pTable->SeededHasher == &PnHashAes)
+    {
+#ifdef PN_HT_HAS_AESNI
+        if (_PnHash_CpuHasAes())
+            return PN_HT_IMAGE_HASH_AES;
+#endif // PN_HT_HAS_AESNI
+        return PN_HT_IMAGE_HASH_WY;
+    }
+
+    return PN_HT_IMAGE_HASH_CUSTOM;
+}
+
+static PN_HT_ALWAYS_INLINE inline uint64_t _PnImg_Align8(uint64_t n)
+{
+    return (n + 7u) & ~(uint64_t)7u;
+}
+
+int PnHtSaveImage(PNHASHTABLEPTR pTable, const char* lpstrPath)
+{
+    static const uint8_t Zeros[8] = { 0 };
+    PNHTIMAGEHEADER Header;
+    PNHTIMAGESLOT* pSlots;
+    uint8_t* pCtrl;
+    uint64_t Cap, Mask, Index, DataPos;
+    PNHTITER It;
+    FILE* pFile;
+    int Ok;
+
+    /* Images cannot record a custom seeded hasher */
+    if ((pTable->Flags & PN_HT_IMAGE) || (pTable->SeededHasher != NULL && _PnImg_HasherId(pTable) == PN_HT_IMAGE_HASH_CUSTOM))
+        return 0;
+
+    /* Read-only, so keep probes short: at most 3/4 full */
+    Cap = _PnHt_RoundPow2((size_t)(pTable->Count + pTable->Count / 3u + 1u));
+    if (Cap < PN_HT_IMAGE_TAIL)
+        Cap = PN_HT_IMAGE_TAIL;
+    Mask = Cap - 1u;
+
+    memset(&Header, 0, sizeof(Header));
+    memcpy(Header.Magic, PN_HT_IMAGE_MAGIC, sizeof(PN_HT_IMAGE_MAGIC));
+    Header.ByteOrder = PN_HT_IMAGE_ORDER;
+    Header.Version = PN_HT_IMAGE_VERSION;
+    Header.Cap = Cap;
+    Header.Count = pTable->Count;
+    Header.Seed = pTable->Seed;
+    Header.HasherId = (uint32_t)_PnImg_HasherId(pTable);
+    Header.CtrlOff = sizeof(PNHTIMAGEHEADER);
+    Header.SlotsOff = _PnImg_Align8(Header.CtrlOff + Cap + PN_HT_IMAGE_TAIL);
+    Header.DataOff = Header.SlotsOff + Cap * sizeof(PNHTIMAGESLOT);
+
+    pCtrl = (uint8_t*)malloc((size_t)(Cap + PN_HT_IMAGE_TAIL));
+    pSlots = (PNHTIMAGESLOT*)calloc((size_t)Cap, sizeof(PNHTIMAGESLOT));
+    if (pCtrl == NULL || pSlots == NULL)
+    {
+        free(pCtrl);
+        free(pSlots);
+        return 0;
+    }
+    memset(pCtrl, PN_HT_CTRL_EMPTY, (size_t)(Cap + PN_HT_IMAGE_TAIL));
+
+    /* First pass places the entries, the data is then written in the same iteration order */
+    DataPos = Header.DataOff;
+    for (PnHtIterBegin(pTable, &It); PnHtIterNext(&It); )
+    {
+        uint32_t Hash = _PnHt_Hash(pTable, It.Key, It.kSize);
+
+        Index = PnHashU32(Hash) & Mask;
+        while (pCtrl[Index] != PN_HT_CTRL_EMPTY)
+            Index = (Index + 1u) & Mask;
+
+        pCtrl[Index] = PN_HT_TAG(Hash);
+        if (Index < PN_HT_IMAGE_TAIL)
+            pCtrl[Cap + Index] = PN_HT_TAG(Hash);
+
+        pSlots[Index].Hash = Hash;
+        pSlots[Index].kSize = (uint32_t)It.kSize;
+        pSlots[Index].vSize = (uint32_t)It.vSize;
+        pSlots[Index].KeyOff = DataPos;
+        DataPos += _PnImg_Align8(It.kSize);
+        pSlots[Index].ValueOff = DataPos;
+        DataPos += _PnImg_Align8(It.vSize);
+    }
+    Header.Size = DataPos;
+
+    pFile = fopen(lpstrPath, "wb");
+    Ok = pFile != NULL;
+    if (Ok)
+    {
+        Ok = fwrite(&Header, sizeof(Header), 1, pFile) == 1 &&
+             fwrite(pCtrl, 1, (size_t)(Cap + PN_HT_IMAGE_TAIL), pFile) == Cap + PN_HT_IMAGE_TAIL &&
+             fwrite(Zeros, 1, (size_t)(Header.SlotsOff - Header.CtrlOff - Cap - PN_HT_IMAGE_TAIL), pFile) == Header.SlotsOff - Header.CtrlOff - Cap - PN_HT_IMAGE_TAIL &&
+             fwrite(pSlots, sizeof(PNHTIMAGESLOT), (size_t)Cap, pFile) == Cap;
+
+        for (PnHtIterBegin(pTable, &It); Ok && PnHtIterNext(&It); )
         {
-            pNext = pBucket->pNext;
-            PnHtInsert(&newtable, pBucket->Key, pBucket->kSize, pBucket->Value, pBucket->vSize);
-            pBucket = pNext;
+            Ok = fwrite(It.Key, 1, It.kSize, pFile) == It.kSize &&
+                 fwrite(Zeros, 1, (size_t)(_PnImg_Align8(It.kSize) - It.kSize), pFile) == _PnImg_Align8(It.kSize) - It.kSize &&
+                 fwrite(It.Value, 1, It.vSize, pFile) == It.vSize &&
+                 fwrite(Zeros, 1, (size_t)(_PnImg_Align8(It.vSize) - It.vSize), pFile) == _PnImg_Align8(It.vSize) - It.vSize;
         }
-        pTable->pBuckets[k] = NULL;
+
+        Ok = (fclose(pFile) == 0) && Ok;
     }
 
-    PnHtDestroy(pTable);
+    free(pCtrl);
+    free(pSlots);
+    return Ok;
+}
+
+/* Maps the whole file read-only, NULL on failure */
+static const uint8_t* _PnImg_Map(const char* lpstrPath, size_t* pSize)
+{
+    const uint8_t* pImage = NULL;
+#ifdef _WIN32
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER Size;
+
+    hFile = CreateFileA(lpstrPath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (GetFileSizeEx(hFile, &Size) && Size.QuadPart >= (LONGLONG)sizeof(PNHTIMAGEHEADER))
+    {
+        hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapping != NULL)
+        {
+            /* The view keeps the mapping alive after both handles are closed */
+            pImage = (const uint8_t*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(hMapping);
+            *pSize = (size_t)Size.QuadPart;
+        }
+    }
+    CloseHandle(hFile);
+#else
+    struct stat Info;
+    void* pMap;
+    int Fd = open(lpstrPath, O_RDONLY);
+    if (Fd < 0)
+        return NULL;
+
+    if (fstat(Fd, &Info) == 0 && Info.st_size >= (off_t)sizeof(PNHTIMAGEHEADER))
+    {
+        pMap = mmap(NULL, (size_t)Info.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+        if (pMap != MAP_FAILED)
+        {
+            pImage = (const uint8_t*)pMap;
+            *pSize = (size_t)Info.st_size;
+        }
+    }
+    close(Fd);
+#endif // _WIN32
+
+    return pImage;
+}
+
+/* Everything PnHtGet/iteration will dereference has to lie inside the mapping: header offsets first
+   (ordered so nothing can overflow), then every occupied slot's key and value. One pass over the
+   control bytes and slots, the data itself is not touched */
+static int _PnImg_Validate(const uint8_t* pImage, uint64_t Size)
+{
+    const PNHTIMAGEHEADER* pHeader = (const PNHTIMAGEHEADER*)pImage;
+    const uint8_t* pCtrl;
+    const PNHTIMAGESLOT* pSlots;
+    uint64_t k, nFull = 0;
+
+    if (memcmp(pHeader->Magic, PN_HT_IMAGE_MAGIC, sizeof(PN_HT_IMAGE_MAGIC)) != 0 ||
+        pHeader->ByteOrder != PN_HT_IMAGE_ORDER || pHeader->Version != PN_HT_IMAGE_VERSION ||
+        pHeader->Size != Size || pHeader->Cap < PN_HT_IMAGE_TAIL || (pHeader->Cap & (pHeader->Cap - 1u)) != 0 ||
+        pHeader->CtrlOff < sizeof(PNHTIMAGEHEADER) || pHeader->CtrlOff > pHeader->SlotsOff ||
+        pHeader->SlotsOff > pHeader->DataOff || pHeader->DataOff > Size || (pHeader->SlotsOff & 7u) != 0 ||
+        pHeader->SlotsOff - pHeader->CtrlOff < pHeader->Cap + PN_HT_IMAGE_TAIL ||
+        (pHeader->DataOff - pHeader->SlotsOff) / sizeof(PNHTIMAGESLOT) < pHeader->Cap ||
+        pHeader->Count >= pHeader->Cap)
+        return 0;
+
+    pCtrl = pImage + pHeader->CtrlOff;
+    pSlots = (const PNHTIMAGESLOT*)(pImage + pHeader->SlotsOff);
+
+    /* Probes read the mirrored tail instead of wrapping */
+    if (memcmp(pCtrl, pCtrl + pHeader->Cap, PN_HT_IMAGE_TAIL) != 0)
+        return 0;
+
+    for (k = 0; k < pHeader->Cap; k++)
+    {
+        const PNHTIMAGESLOT* pSlot = &pSlots[k];
+        if (pCtrl[k] & PN_HT_CTRL_EMPTY)
+            continue;
+
+        if (pSlot->KeyOff < pHeader->DataOff || pSlot->KeyOff > Size || pSlot->kSize > Size - pSlot->KeyOff ||
+            pSlot->ValueOff < pHeader->DataOff || pSlot->ValueOff > Size || pSlot->vSize > Size - pSlot->ValueOff)
+            return 0;
+        nFull++;
+    }
+
+    /* At least one empty slot is left, so every probe sequence ends */
+    return nFull == pHeader->Count;
+}
+
+PNHASHTABLE PnHtOpenImage(const char* lpstrPath, pfn_Hasher* Hash)
+{
+    PNHASHTABLE Table = PnHtCreate(PN_HT_NONE, 0.0, Hash, 1);
+    const PNHTIMAGEHEADER* pHeader;
+    size_t Size = 0;
+    int Ok;
+
+    /* Only the hasher settings of the placeholder table are kept, a failed open leaves it empty and read-only */
+    free(Table.pBuckets);
+    Table.pBuckets = NULL;
+    Table.Cap = 0;
+    Table.MinCap = 0;
+    Table.Flags = PN_HT_IMAGE;
+
+    Table.pImage = _PnImg_Map(lpstrPath, &Size);
+    if (Table.pImage == NULL)
+        return Table;
+    Table.ImageSize = Size;
+
+    pHeader = (const PNHTIMAGEHEADER*)Table.pImage;
+    Ok = _PnImg_Validate(Table.pImage, Size);
+
+    switch (pHeader->HasherId)
+    {
+    case PN_HT_IMAGE_HASH_WY:
+        Table.Hasher = NULL;
+        Table.SeededHasher = &PnHashWy;
+        break;
+    case PN_HT_IMAGE_HASH_AES:
+        Table.Hasher = NULL;
+        Table.SeededHasher = &PnHashAes;
+#ifdef PN_HT_HAS_AESNI
+        Ok = Ok && _PnHash_CpuHasAes();
+#else
+        Ok = 0;
+#endif // PN_HT_HAS_AESNI
+        break;
+    default:
+        /* Built with a custom hasher: only the caller knows which one */
+        Ok = Ok && Hash != NULL;
+        break;
+    }
+
+    if (!Ok)
+    {
+        _PnImg_Unmap(&Table);
+        return Table;
+    }
+
+    Table.Seed = pHeader->Seed;
+    Table.Cap = (size_t)pHeader->Cap;
+    Table.Count = (size_t)pHeader->Count;
+    return Table;
+}
+
+#ifdef PN_HT_THREADS
+/* Reader/writer lock shim: SRW locks on Windows, pthreads everywhere else */
+#ifdef _WIN32
+  #include <windows.h>
+  typedef SRWLOCK PNHTRWLOCK;
+  #define _PnRw_Init(pLock)         InitializeSRWLock(pLock)
+  #define _PnRw_Destroy(pLock)      ((void)(pLock))
+  #define _PnRw_ReadLock(pLock)     AcquireSRWLockShared(pLock)
+  #define _PnRw_ReadUnlock(pLock)   ReleaseSRWLockShared(pLock)
+  #define _PnRw_WriteLock(pLock)    AcquireSRWLockExclusive(pLock)
+  #define _PnRw_WriteUnlock(pLock)  ReleaseSRWLockExclusive(pLock)
+#else
+  #include <pthread.h>
+  typedef pthread_rwlock_t PNHTRWLOCK;
+  #define _PnRw_Init(pLock)         pthread_rwlock_init(pLock, NULL)
+  #define _PnRw_Destroy(pLock)      pthread_rwlock_destroy(pLock)
+  #define _PnRw_ReadLock(pLock)     pthread_rwlock_rdlock(pLock)
+  #define _PnRw_ReadUnlock(pLock)   pthread_rwlock_unlock(pLock)
+  #define _PnRw_WriteLock(pLock)    pthread_rwlock_wrlock(pLock)
+  #define _PnRw_WriteUnlock(pLock)  pthread_rwlock_unlock(pLock)
+#endif // _WIN32
+
+typedef struct
+{
+    PNHTRWLOCK  Lock;
+    size_t      Count;
+    uint32_t    Collisions;
+    uint32_t    Gen;  /* Generation of the bucket array the stripe's buckets live in */
+} PNHTSTRIPE;
+
+/* Padded to whole cache lines so two stripes never share one */
+typedef union
+{
+    PNHTSTRIPE  Stripe;
+    char        _Pad[(sizeof(PNHTSTRIPE) + 63u) / 64u * 64u];
+} PNHTSTRIPESLOT;
+
+struct __sPNHTLOCKS
+{
+    PNHTSTRIPESLOT Stripes[PN_HT_LOCK_STRIPES];
+    PNHTRWLOCK     ResizeLock; /* Serializes resizers, never taken by lookups */
+    void*          pBlock;     /* Unaligned allocation */
+};
+
+/* CONCURRENT HASH TABLE FUNCTIONS */
+static PN_HT_ALWAYS_INLINE inline PNHTSTRIPE* _PnHtc_Stripe(PNHTCONCURRENTPTR pTable, uint32_t Hash)
+{
+    return &pTable->pLocks->Stripes[PnHashU32(Hash) & (PN_HT_LOCK_STRIPES - 1u)].Stripe;
+}
+
+/* Caller holds the stripe's lock */
+static PN_HT_ALWAYS_INLINE inline PNBUCKETPTR* _PnHtc_Head(PNHTCONCURRENTPTR pTable, PNHTSTRIPE* pStripe, uint32_t Hash)
+{
+    uint32_t g = pStripe->Gen & 1u;
+    return &pTable->pBuckets[g][_PnHt_IndexCap(&pTable->Table, Hash, pTable->Cap[g])];
+}
+
+/**
+ * Caller holds "ResizeLock". Bucket k belongs to stripe k % PN_HT_LOCK_STRIPES at every power-of-two
+ * size, so the stripes are moved one at a time and the others keep serving lookups meanwhile.
+**/
+static void _PnHtc_Migrate(PNHTCONCURRENTPTR pTable, size_t NewSize)
+{
+    uint32_t Old = pTable->Gen & 1u, New = Old ^ 1u;
+    size_t OldCap = pTable->Cap[Old];
+    size_t s, k, Index;
+    PNBUCKETPTR* pNewBuckets;
+    PNBUCKETPTR pBucket, pNext;
+    PNHTSTRIPE* pStripe;
+
+    NewSize = _PnHt_RoundPow2(NewSize < PN_HT_LOCK_STRIPES ? PN_HT_LOCK_STRIPES : NewSize);
+    if (NewSize == OldCap)
+        return;
+
+    pNewBuckets = (PNBUCKETPTR*)calloc(NewSize, sizeof(PNBUCKETPTR));
+    if (pNewBuckets == NULL)
+        return;
+
+    pTable->pBuckets[New] = pNewBuckets;
+    pTable->Cap[New] = NewSize;
+
+    for (s = 0; s < PN_HT_LOCK_STRIPES; s++)
+    {
+        pStripe = &pTable->pLocks->Stripes[s].Stripe;
+        _PnRw_WriteLock(&pStripe->Lock);
+
+        pStripe->Collisions = 0;
+        for (k = s; k < OldCap; k += PN_HT_LOCK_STRIPES)
+        {
+            for (pBucket = pTable->pBuckets[Old][k]; pBucket != NULL; pBucket = pNext)
+            {
+                pNext = pBucket->pNext;
+                Index = _PnHt_IndexCap(&pTable->Table, pBucket->Hash, NewSize);
+
+                if (pNewBuckets[Index] != NULL)
+                    pStripe->Collisions++;
+
+                pBucket->pNext = pNewBuckets[Index];
+                pNewBuckets[Index] = pBucket;
+            }
+        }
+        pStripe->Gen = pTable->Gen + 1u;
+
+        _PnRw_WriteUnlock(&pStripe->Lock);
+    }
+
+    /* Every stripe has moved on, nobody can still be reading the old array */
+    free(pTable->pBuckets[Old]);
+    pTable->pBuckets[Old] = NULL;
+    pTable->Cap[Old] = 0;
+    pTable->Gen++;
+    return;
+}
+
+/* "SeenCap" is the size the caller found overloaded, another thread may have grown the table since */
+static void _PnHtc_Grow(PNHTCONCURRENTPTR pTable, size_t SeenCap)
+{
+    _PnRw_WriteLock(&pTable->pLocks->ResizeLock);
+
+    if (pTable->Cap[pTable->Gen & 1u] == SeenCap)
+        _PnHtc_Migrate(pTable, SeenCap * 2u);
+
+    _PnRw_WriteUnlock(&pTable->pLocks->ResizeLock);
+    return;
+}
+
+PNHTCONCURRENT PnHtcCreate(uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap)
+{
+    PNHTCONCURRENT Table;
+    void* pBlock;
+    size_t s;
+
+    /* Power-of-two sizes keep every bucket in the same stripe across resizes */
+    Flags = (Flags & (PN_HT_COPY_KV | PN_HT_NO_RESIZE)) | PN_HT_POW2;
+    Table.Table = PnHtCreate(Flags, MLF, Hash, Cap < PN_HT_LOCK_STRIPES ? PN_HT_LOCK_STRIPES : Cap);
+
+    /* The bucket arrays are owned by the generations instead */
+    Table.pBuckets[0] = Table.Table.pBuckets;
+    Table.pBuckets[1] = NULL;
+    Table.Cap[0] = Table.Table.Cap;
+    Table.Cap[1] = 0;
+    Table.Gen = 0;
+    Table.Table.pBuckets = NULL;
+
+    pBlock = Table.pBuckets[0] != NULL ? malloc(sizeof(struct __sPNHTLOCKS) + 63u) : NULL;
+    if (pBlock == NULL)
+    {
+        /* Out of memory: nothing half-built is handed out, callers see "pLocks == NULL" */
+        Table.Table.pBuckets = Table.pBuckets[0];
+        if (Table.Table.pBuckets == NULL)
+            Table.Table.Cap = 0;
+        PnHtDestroy(&Table.Table);
+        memset(&Table, 0, sizeof(Table));
+        return Table;
+    }
+
+    Table.pLocks = (PNHTLOCKSPTR)(((uintptr_t)pBlock + 63u) & ~(uintptr_t)63u);
+    Table.pLocks->pBlock = pBlock;
+    _PnRw_Init(&Table.pLocks->ResizeLock);
+
+    for (s = 0; s < PN_HT_LOCK_STRIPES; s++)
+    {
+        PNHTSTRIPE* pStripe = &Table.pLocks->Stripes[s].Stripe;
+        _PnRw_Init(&pStripe->Lock);
+        pStripe->Count = 0;
+        pStripe->Collisions = 0;
+        pStripe->Gen = 0;
+    }
+
+    return Table;
+}
+
+void PnHtcDestroy(PNHTCONCURRENTPTR pTable)
+{
+    size_t s;
+
+    /* A failed PnHtcCreate left nothing to release */
+    if (pTable->pLocks == NULL)
+        return;
+
+    for (s = 0; s < PN_HT_LOCK_STRIPES; s++)
+        _PnRw_Destroy(&pTable->pLocks->Stripes[s].Stripe.Lock);
+
+    _PnRw_Destroy(&pTable->pLocks->ResizeLock);
+    free(pTable->pLocks->pBlock);
+    pTable->pLocks = NULL;
+
+    /* Hand the live array back so PnHtDestroy releases it with the buckets */
+    pTable->Table.pBuckets = pTable->pBuckets[pTable->Gen & 1u];
+    pTable->Table.Cap = pTable->Cap[pTable->Gen & 1u];
+    PnHtDestroy(&pTable->Table);
+
+    pTable->pBuckets[0] = NULL;
+    pTable->pBuckets[1] = NULL;
+    pTable->Cap[0] = 0;
+    pTable->Cap[1] = 0;
+    return;
+}
+
+int PnHtcInsert(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    uint32_t Hash;
+    PNHTSTRIPE* pStripe;
+    PNBUCKETPTR* pHead;
+    PNBUCKETPTR pBucket;
+    size_t SeenCap = 0;
+    int Stored = 0;
+
+    if (pTable->pLocks == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->Table, Key, kSize);
+    pStripe = _PnHtc_Stripe(pTable, Hash);
+
+    _PnRw_WriteLock(&pStripe->Lock);
+
+    pHead = _PnHtc_Head(pTable, pStripe, Hash);
+    pBucket = _PnHt_FindInChain(&pTable->Table, *pHead, Hash, Key, kSize);
+
+    if (pBucket != NULL)
+        Stored = _PnBkt_SetValue(&pTable->Table, pBucket, Value, vSize);
+    else if ((pBucket = _PnBkt_Create(&pTable->Table, Hash, Key, kSize, Value, vSize)) != NULL)
+    {
+        Stored = 1;
+        if (*pHead != NULL)
+            pStripe->Collisions++;
+
+        pBucket->pNext = *pHead;
+        *pHead = pBucket;
+        pStripe->Count++;
+
+        /* A stripe owns 1/PN_HT_LOCK_STRIPES of the buckets, so its own load factor stands in for the table's */
+        if (!(pTable->Table.Flags & PN_HT_NO_RESIZE) &&
+            (double)pStripe->Collisions * PN_HT_LOCK_STRIPES > pTable->Table.MLF * (double)pTable->Cap[pStripe->Gen & 1u])
+            SeenCap = pTable->Cap[pStripe->Gen & 1u];
+    }
+
+    _PnRw_WriteUnlock(&pStripe->Lock);
 
-    pTable->Flags = newtable.Flags;
-    pTable->Hasher = newtable.Hasher;
-    pTable->Count = newtable.Count;
-    pTable->Cap = newtable.Cap;
-    pTable->Collisions = newtable.Collisions;
-    pTable->MLF = newtable.MLF;
-    pTable->CLF = newtable.CLF;
-    pTable->pBuckets = newtable.pBuckets;
+    if (SeenCap != 0)
+        _PnHtc_Grow(pTable, SeenCap);
+
+    return Stored;
+}
+
+int PnHtcGet(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize, void* pValue, size_t vSize, size_t* pvSize)
+{
+    uint32_t Hash;
+    PNHTSTRIPE* pStripe;
+    PNBUCKETPTR pBucket;
+
+    if (pvSize != NULL) *pvSize = 0;
+    if (pTable->pLocks == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->Table, Key, kSize);
+    pStripe = _PnHtc_Stripe(pTable, Hash);
+
+    _PnRw_ReadLock(&pStripe->Lock);
+
+    pBucket = _PnHt_FindInChain(&pTable->Table, *_PnHtc_Head(pTable, pStripe, Hash), Hash, Key, kSize);
+    if (pBucket != NULL)
+    {
+        memcpy(pValue, _PnBkt_Value(&pTable->Table, pBucket), pBucket->vSize < vSize ? pBucket->vSize : vSize);
+        if (pvSize != NULL) *pvSize = pBucket->vSize;
+    }
+
+    _PnRw_ReadUnlock(&pStripe->Lock);
+    return pBucket != NULL;
+}
+
+int PnHtcRemove(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize)
+{
+    uint32_t Hash;
+    PNHTSTRIPE* pStripe;
+    PNBUCKETPTR pBucket;
+    int Collision;
+
+    if (pTable->pLocks == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->Table, Key, kSize);
+    pStripe = _PnHtc_Stripe(pTable, Hash);
+
+    _PnRw_WriteLock(&pStripe->Lock);
+
+    pBucket = _PnHt_UnlinkFromChain(&pTable->Table, _PnHtc_Head(pTable, pStripe, Hash), Hash, Key, kSize, &Collision);
+    if (pBucket != NULL)
+    {
+        pStripe->Collisions -= (uint32_t)Collision;
+        pStripe->Count--;
+        _PnBkt_Destroy(&pTable->Table, pBucket);
+    }
+
+    _PnRw_WriteUnlock(&pStripe->Lock);
+    return pBucket != NULL;
+}
+
+int PnHtcContains(PNHTCONCURRENTPTR pTable, const void* Key, size_t kSize)
+{
+    uint32_t Hash;
+    PNHTSTRIPE* pStripe;
+    PNBUCKETPTR pBucket;
+
+    if (pTable->pLocks == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->Table, Key, kSize);
+    pStripe = _PnHtc_Stripe(pTable, Hash);
+
+    _PnRw_ReadLock(&pStripe->Lock);
+    pBucket = _PnHt_FindInChain(&pTable->Table, *_PnHtc_Head(pTable, pStripe, Hash), Hash, Key, kSize);
+    _PnRw_ReadUnlock(&pStripe->Lock);
+
+    return pBucket != NULL;
+}
+
+/* Sum over the stripes, each one read under its lock (exact only while no writer runs) */
+size_t PnHtcCount(PNHTCONCURRENTPTR pTable)
+{
+    size_t s, Count = 0;
+
+    for (s = 0; s < PN_HT_LOCK_STRIPES && pTable->pLocks != NULL; s++)
+    {
+        PNHTSTRIPE* pStripe = &pTable->pLocks->Stripes[s].Stripe;
+        _PnRw_ReadLock(&pStripe->Lock);
+        Count += pStripe->Count;
+        _PnRw_ReadUnlock(&pStripe->Lock);
+    }
+
+    return Count;
+}
+
+void PnHtcResize(PNHTCONCURRENTPTR pTable, size_t NewSize)
+{
+    if (pTable->pLocks == NULL) return;
+    _PnRw_WriteLock(&pTable->pLocks->ResizeLock);
+    _PnHtc_Migrate(pTable, NewSize);
+    _PnRw_WriteUnlock(&pTable->pLocks->ResizeLock);
+    return;
+}
+
+/* Thread shim for PnHtForEachParallel */
+#ifdef _WIN32
+  typedef HANDLE PNHTTHREAD;
+  #define PN_HT_THREAD_PROC(Name, pArg)         static DWORD WINAPI Name(LPVOID pArg)
+  #define PN_HT_THREAD_RETURN                   0
+  #define _PnThread_Start(pThread, Proc, pArg)  ((*(pThread) = CreateThread(NULL, 0, Proc, pArg, 0, NULL)) != NULL)
+  #define _PnThread_Join(Thread)                (WaitForSingleObject(Thread, INFINITE), CloseHandle(Thread))
+#else
+  typedef pthread_t PNHTTHREAD;
+  #define PN_HT_THREAD_PROC(Name, pArg)         static void* Name(void* pArg)
+  #define PN_HT_THREAD_RETURN                   NULL
+  #define _PnThread_Start(pThread, Proc, pArg)  (pthread_create(pThread, NULL, Proc, pArg) == 0)
+  #define _PnThread_Join(Thread)                pthread_join(Thread, NULL)
+#endif // _WIN32
+
+typedef struct
+{
+    PNHASHTABLEPTR pTable;
+    size_t         Start;
+    size_t         End;
+    pfn_HtVisit*   Visit;
+    void*          pCtx;
+    size_t         nVisited;
+    PNHTTHREAD     Thread;
+    int            Started;
+} PNHTVISITJOB;
+
+PN_HT_THREAD_PROC(_PnHt_VisitJob, pArg)
+{
+    PNHTVISITJOB* pJob = (PNHTVISITJOB*)pArg;
+    pJob->nVisited = _PnHt_VisitRange(pJob->pTable, pJob->Start, pJob->End, pJob->Visit, pJob->pCtx);
+    return PN_HT_THREAD_RETURN;
+}
+
+size_t PnHtForEachParallel(PNHASHTABLEPTR pTable, uint32_t nThreads, pfn_HtVisit* Visit, void* pCtx)
+{
+    size_t Space = _PnHt_VisitSpace(pTable);
+    size_t Step, k, nVisited = 0;
+    PNHTVISITJOB* pJobs;
+
+    if (nThreads > Space / 1024u)
+        nThreads = (uint32_t)(Space / 1024u);
+    if (nThreads <= 1u)
+        return PnHtForEach(pTable, Visit, pCtx);
+
+    pJobs = (PNHTVISITJOB*)malloc(nThreads * sizeof(PNHTVISITJOB));
+    if (pJobs == NULL)
+        return PnHtForEach(pTable, Visit, pCtx);
+
+    /* Contiguous ranges, so each thread streams through its own part of the arrays */
+    Step = (Space + nThreads - 1u) / nThreads;
+    for (k = 0; k < nThreads; k++)
+    {
+        pJobs[k].pTable = pTable;
+        pJobs[k].Start = k * Step;
+        pJobs[k].End = (k + 1u) * Step < Space ? (k + 1u) * Step : Space;
+        pJobs[k].Visit = Visit;
+        pJobs[k].pCtx = pCtx;
+        pJobs[k].nVisited = 0;
+        pJobs[k].Started = k != 0 && _PnThread_Start(&pJobs[k].Thread, &_PnHt_VisitJob, &pJobs[k]);
+    }
+
+    /* The calling thread takes the first range, and any range whose thread failed to start */
+    for (k = 0; k < nThreads; k++)
+        if (!pJobs[k].Started)
+            _PnHt_VisitJob(&pJobs[k]);
+
+    for (k = 0; k < nThreads; k++)
+    {
+        if (pJobs[k].Started)
+            _PnThread_Join(pJobs[k].Thread);
+        nVisited += pJobs[k].nVisited;
+    }
+
+    free(pJobs);
+    return nVisited;
+}
+
+/* One independent table per shard, padded so neighbouring shards' locks never share a cache line */
+typedef struct
+{
+    PNHASHTABLE Table;
+    PNHTRWLOCK  Lock;
+} PNHTSHARDDATA;
+
+struct __sPNHTSHARD
+{
+    union
+    {
+        PNHTSHARDDATA Shard;
+        char          _Pad[(sizeof(PNHTSHARDDATA) + 63u) / 64u * 64u];
+    } u;
+};
+
+/* SHARDED HASH TABLE FUNCTIONS */
+
+/**
+ * The shard comes from the top bits of the mixed hash: the raw top bits are the open addressing tag
+ * and the low mixed bits the PN_HT_POW2 index, so both keep their full spread inside a shard.
+**/
+static PN_HT_ALWAYS_INLINE inline PNHTSHARDDATA* _PnHts_Shard(PNHTSHARDEDPTR pTable, uint32_t Hash)
+{
+    uint32_t Index = pTable->ShardBits != 0 ? PnHashU32(Hash) >> (32u - pTable->ShardBits) : 0u;
+    return &pTable->pShards[Index].u.Shard;
+}
+
+/* Lookups of PN_HT_INCREMENTAL shards migrate buckets, so they need the lock exclusively as well */
+static PN_HT_ALWAYS_INLINE inline void _PnHts_ReadLock(PNHTSHARDDATA* pShard)
+{
+    if (pShard->Table.Flags & PN_HT_INCREMENTAL)
+        _PnRw_WriteLock(&pShard->Lock);
+    else
+        _PnRw_ReadLock(&pShard->Lock);
+}
+
+static PN_HT_ALWAYS_INLINE inline void _PnHts_ReadUnlock(PNHTSHARDDATA* pShard)
+{
+    if (pShard->Table.Flags & PN_HT_INCREMENTAL)
+        _PnRw_WriteUnlock(&pShard->Lock);
+    else
+        _PnRw_ReadUnlock(&pShard->Lock);
+}
+
+PNHTSHARDED PnHtsCreate(uint32_t nShards, uint32_t Flags, double MLF, pfn_Hasher* Hash, int Cap)
+{
+    PNHTSHARDED Table;
+    PNHTSHARDDATA* pShard;
+    void* pBlock;
+    uint32_t k;
+
+    Table.ShardBits = 0;
+    while ((1u << Table.ShardBits) < nShards && Table.ShardBits < 16u)
+        Table.ShardBits++;
+    Table.nShards = 1u << Table.ShardBits;
+
+    pBlock = malloc(Table.nShards * sizeof(struct __sPNHTSHARD) + 63u);
+    Table.pBlock = pBlock;
+    if (pBlock == NULL)
+    {
+        /* Out of memory: callers see "pShards == NULL" */
+        Table.pShards = NULL;
+        Table.nShards = 0;
+        Table.ShardBits = 0;
+        return Table;
+    }
+    Table.pShards = (PNHTSHARDPTR)(((uintptr_t)pBlock + 63u) & ~(uintptr_t)63u);
+
+    for (k = 0; k < Table.nShards; k++)
+    {
+        pShard = &Table.pShards[k].u.Shard;
+        pShard->Table = PnHtCreate(Flags, MLF, Hash, Cap > 0 ? (Cap + (int)Table.nShards - 1) / (int)Table.nShards : 0);
+        if (pShard->Table.Cap == 0)
+        {
+            /* A shard ran out of memory: unwind the ones built so far, the failed one holds nothing */
+            Table.nShards = k;
+            PnHtsDestroy(&Table);
+            return Table;
+        }
+        _PnRw_Init(&pShard->Lock);
+
+        /* Every shard must hash exactly like the first one, which also picks the shard */
+        if (k != 0)
+        {
+            pShard->Table.SeededHasher = Table.pShards[0].u.Shard.Table.SeededHasher;
+            pShard->Table.Seed = Table.pShards[0].u.Shard.Table.Seed;
+        }
+    }
+
+    return Table;
+}
+
+void PnHtsDestroy(PNHTSHARDEDPTR pTable)
+{
+    uint32_t k;
+
+    for (k = 0; k < pTable->nShards; k++)
+    {
+        PnHtDestroy(&pTable->pShards[k].u.Shard.Table);
+        _PnRw_Destroy(&pTable->pShards[k].u.Shard.Lock);
+    }
+
+    free(pTable->pBlock);
+    pTable->pBlock = NULL;
+    pTable->pShards = NULL;
+    pTable->nShards = 0;
+    pTable->ShardBits = 0;
+    return;
+}
+
+int PnHtsInsert(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize, const void* Value, size_t vSize)
+{
+    uint32_t Hash;
+    PNHTSHARDDATA* pShard;
+    int Result;
+
+    if (pTable->pShards == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->pShards[0].u.Shard.Table, Key, kSize);
+    pShard = _PnHts_Shard(pTable, Hash);
+
+    /* A resize triggered here only ever blocks this shard */
+    _PnRw_WriteLock(&pShard->Lock);
+    Result = _PnHt_InsertHashed(&pShard->Table, Hash, Key, kSize, Value, vSize);
+    _PnRw_WriteUnlock(&pShard->Lock);
+    return Result;
+}
+
+int PnHtsGet(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize, void* pValue, size_t vSize, size_t* pvSize)
+{
+    uint32_t Hash;
+    PNHTSHARDDATA* pShard;
+    void* pStored;
+    size_t StoredSize = 0;
+    int Found;
+
+    if (pvSize != NULL) *pvSize = 0;
+    if (pTable->pShards == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->pShards[0].u.Shard.Table, Key, kSize);
+    pShard = _PnHts_Shard(pTable, Hash);
+
+    _PnHts_ReadLock(pShard);
+    Found = _PnHt_LookupHashed(&pShard->Table, Hash, Key, kSize, &pStored, &StoredSize);
+    if (Found)
+        memcpy(pValue, pStored, StoredSize < vSize ? StoredSize : vSize);
+    _PnHts_ReadUnlock(pShard);
+
+    if (pvSize != NULL) *pvSize = StoredSize;
+    return Found;
+}
+
+int PnHtsRemove(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize)
+{
+    uint32_t Hash;
+    PNHTSHARDDATA* pShard;
+    int Removed;
+
+    if (pTable->pShards == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->pShards[0].u.Shard.Table, Key, kSize);
+    pShard = _PnHts_Shard(pTable, Hash);
+
+    _PnRw_WriteLock(&pShard->Lock);
+    Removed = _PnHt_RemoveHashed(&pShard->Table, Hash, Key, kSize);
+    _PnRw_WriteUnlock(&pShard->Lock);
+
+    return Removed;
+}
+
+int PnHtsContains(PNHTSHARDEDPTR pTable, const void* Key, size_t kSize)
+{
+    uint32_t Hash;
+    PNHTSHARDDATA* pShard;
+    void* pStored;
+    int Found;
+
+    if (pTable->pShards == NULL) return 0;
+    Hash = _PnHt_Hash(&pTable->pShards[0].u.Shard.Table, Key, kSize);
+    pShard = _PnHts_Shard(pTable, Hash);
+
+    _PnHts_ReadLock(pShard);
+    Found = _PnHt_LookupHashed(&pShard->Table, Hash, Key, kSize, &pStored, NULL);
+    _PnHts_ReadUnlock(pShard);
+
+    return Found;
+}
+
+void PnHtsSetMinLoad(PNHTSHARDEDPTR pTable, double MinLF)
+{
+    uint32_t k;
+
+    for (k = 0; k < pTable->nShards; k++)
+    {
+        _PnRw_WriteLock(&pTable->pShards[k].u.Shard.Lock);
+        PnHtSetMinLoad(&pTable->pShards[k].u.Shard.Table, MinLF);
+        _PnRw_WriteUnlock(&pTable->pShards[k].u.Shard.Lock);
+    }
+
+    return;
+}
+
+/* Sums "Count" and "Collisions" and reports the largest shard, one shard lock at a time */
+void PnHtsGetTotals(PNHTSHARDEDPTR pTable, size_t* pCount, uint64_t* pCollisions, size_t* pMaxShardCount)
+{
+    size_t Count = 0, MaxShard = 0;
+    uint64_t Collisions = 0;
+    uint32_t k;
+
+    for (k = 0; k < pTable->nShards; k++)
+    {
+        PNHTSHARDDATA* pShard = &pTable->pShards[k].u.Shard;
+
+        _PnHts_ReadLock(pShard);
+        Count += pShard->Table.Count;
+        Collisions += pShard->Table.Collisions;
+        if (pShard->Table.Count > MaxShard)
+            MaxShard = pShard->Table.Count;
+        _PnHts_ReadUnlock(pShard);
+    }
 
+    if (pCount != NULL)
+        *pCount = Count;
+    if (pCollisions != NULL)
+        *pCollisions = Collisions;
+    if (pMaxShardCount != NULL)
+        *pMaxShardCount = MaxShard;
     return;
 }
+#endif // PN_HT_THREADS
 
 #endif // PN_HASHTABLE_IMPLEMENTATION
 
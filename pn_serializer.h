@@ -7,7 +7,35 @@
 #include <string.h>
 #include <time.h>
 
-#define PN_SERIALIZER_BUFSIZE        512
+#define PN_SERIALIZER_BUFSIZE        512   /* Initial capacity, doubled whenever a write doesn't fit */
+
+#ifndef PN_SERIALIZER_CHUNK
+  #define PN_SERIALIZER_CHUNK        (1u << 20)  /* PN_SER_STREAM: buffered bytes per write to the file */
+#endif // PN_SERIALIZER_CHUNK
+
+#define PN_SERIALIZER_STREAMED       0xFFFFFFFFUL  /* FullSize of a streamed file, the real length is in the trailer */
+#define PN_SERIALIZER_COMPRESSED     0xFFFFFFFEUL  /* FullSize of a PN_SER_COMPRESS file: blocks, block index, footer */
+#define PN_SERIALIZER_MAXSIZE        0xFFFFFFF9UL  /* Largest buffered payload, so its FullSize (+4) stays below the markers */
+
+#ifndef PN_SERIALIZER_BLOCK
+  #define PN_SERIALIZER_BLOCK        (1u << 18)  /* PN_SER_COMPRESS: raw bytes per independently packed block */
+#endif // PN_SERIALIZER_BLOCK
+
+#ifndef PN_SERIALIZER_THREADS
+  #define PN_SERIALIZER_THREADS      4           /* PN_SER_THREADS builds: threads packing/unpacking blocks at once */
+#endif // PN_SERIALIZER_THREADS
+
+#if defined(__GNUC__)
+  #define PN_SER_LIKELY(x)    __builtin_expect(!!(x), 1)
+  #define PN_SER_UNLIKELY(x)  __builtin_expect(!!(x), 0)
+#else
+  #define PN_SER_LIKELY(x)    (x)
+  #define PN_SER_UNLIKELY(x)  (x)
+#endif // __GNUC__
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_M_IX86) || defined(_M_X64) || defined(_M_ARM64)
+  #define PN_SER_LITTLE_ENDIAN
+#endif
 
 /**
  * I have no idea why I like the Windows type-naming convention so much
@@ -25,6 +53,16 @@ extern "C" {
 #endif // PN_SERIALIZER_IMPLEMENTATION
 
 
+typedef enum
+{
+    PN_SER_NONE        = 0x00,
+    PN_SER_STREAM      = 0x01, /* PnSerializationBeginStream: "pBuffer" is flushed to "pFile" as it fills */
+    PN_SER_MAPPED      = 0x02, /* PnDeserializationBeginMapped: "pBuffer" points into a read-only file mapping */
+    PN_SER_VARINT      = 0x04, /* Integers as zigzag LEB128, lengths as plain LEB128; set on both ends */
+    PN_SER_ERROR       = 0x08, /* Sticky: a write failed or a read ran past the data, see the End calls */
+    PN_SER_COMPRESS    = 0x10, /* Written as LZ-packed, checksummed blocks; readers detect it from the file */
+} PN_SER_FLAGS;
+
 typedef struct __sPNSERIALIZER
 {
     char*     pBuffer;   /* Data to be serialized to the file */
@@ -32,6 +70,15 @@ typedef struct __sPNSERIALIZER
     uint32_t  Size;      /* Total size of "pData" in bytes    */
     uint32_t  _Cap;      /* Total available memory in "pData" */
     FILE*     pFile;     /* Output of ~ & Input of de~        */
+    uint32_t  Flags;     /* PN_SER_FLAGS                      */
+    uint64_t  Flushed;   /* PN_SER_STREAM: bytes already in "pFile", not counting the header */
+    void*     pMapping;  /* PN_SER_MAPPED: start of the mapping ("pBuffer" is past the header) */
+    size_t    MapSize;   /* PN_SER_MAPPED: length of the mapping, "Size" saturates at 4GB      */
+    char*     pEnd;      /* Deserialization: one past the payload, reads never go beyond it    */
+    uint64_t  Written;   /* PN_SER_STREAM/PN_SER_COMPRESS: bytes in "pFile", header included   */
+    uint64_t* pIndex;    /* PN_SER_COMPRESS: file offset of every block written so far         */
+    uint32_t  nBlocks;   /* PN_SER_COMPRESS: entries in "pIndex"                               */
+    uint32_t  _IndexCap; /* PN_SER_COMPRESS: available entries in "pIndex"                     */
 } PNSERIALIZER;
 
 typedef PNSERIALIZER*          PNSERIALIZERPTR;
@@ -39,9 +86,16 @@ typedef const PNSERIALIZER*    PNSERIALIZERCPTR;
 
 
 PNSERIALIZER_API void PnSerializationBegin(PNSERIALIZERPTR pData);
+PNSERIALIZER_API int  PnSerializationBeginStream(PNSERIALIZERPTR pData, const char* lpstrFilename);
 PNSERIALIZER_API int  PnSerializationEnd(PNSERIALIZERPTR pData, const char* lpstrFilename);
 PNSERIALIZER_API int  PnDeserializationBegin(PNSERIALIZERPTR pData, const char* lpstrFilename);
+PNSERIALIZER_API int  PnDeserializationBeginMapped(PNSERIALIZERPTR pData, const char* lpstrFilename);
+PNSERIALIZER_API int  PnDeserializationBeginRange(PNSERIALIZERPTR pData, const char* lpstrFilename, uint64_t Offset, uint64_t Length);
 PNSERIALIZER_API int  PnDeserializationEnd(PNSERIALIZERPTR pData, void** pMemBlocks, int32_t nMemBlocks);
+PNSERIALIZER_API int  PnSerializerReserve(PNSERIALIZERPTR pData, uint32_t Bytes);
+PNSERIALIZER_API void PnSerializerSetFlags(PNSERIALIZERPTR pData, uint32_t Flags);
+PNSERIALIZER_API void PnSerializerClearFlags(PNSERIALIZERPTR pData, uint32_t Flags);
+PNSERIALIZER_API uint64_t PnSerializerTell(PNSERIALIZERCPTR pData);
 
 PNSERIALIZER_API void PnWriteBytes(PNSERIALIZERPTR pData, const void* pBytes, int32_t nSize);
 PNSERIALIZER_API void PnWriteString(PNSERIALIZERPTR pData, const char* lpstrString, int32_t nLength);
@@ -52,8 +106,16 @@ PNSERIALIZER_API void PnWriteInt64(PNSERIALIZERPTR pData, int64_t Value);
 PNSERIALIZER_API void PnWriteFloat32(PNSERIALIZERPTR pData, float Value);
 PNSERIALIZER_API void PnWriteFloat64(PNSERIALIZERPTR pData, double Value);
 
+PNSERIALIZER_API void PnWriteInt16Array(PNSERIALIZERPTR pData, const int16_t* pValues, uint32_t nCount);
+PNSERIALIZER_API void PnWriteInt32Array(PNSERIALIZERPTR pData, const int32_t* pValues, uint32_t nCount);
+PNSERIALIZER_API void PnWriteInt64Array(PNSERIALIZERPTR pData, const int64_t* pValues, uint32_t nCount);
+PNSERIALIZER_API void PnWriteFloat32Array(PNSERIALIZERPTR pData, const float* pValues, uint32_t nCount);
+PNSERIALIZER_API void PnWriteFloat64Array(PNSERIALIZERPTR pData, const double* pValues, uint32_t nCount);
+
 PNSERIALIZER_API void    PnReadBytes(PNSERIALIZERPTR pData, void** pBytes, uint32_t* pSize);
 PNSERIALIZER_API void    PnReadString(PNSERIALIZERPTR pData, char** lpstrString, int32_t* pLength);
+PNSERIALIZER_API void    PnReadBytesView(PNSERIALIZERPTR pData, const void** pBytes, uint32_t* pSize);
+PNSERIALIZER_API void    PnReadStringView(PNSERIALIZERPTR pData, const char** lpstrString, int32_t* pLength);
 PNSERIALIZER_API void    PnReadDatetime(PNSERIALIZERPTR pData, struct tm** pDatetime);
 PNSERIALIZER_API int16_t PnReadInt16(PNSERIALIZERPTR pData);
 PNSERIALIZER_API int32_t PnReadInt32(PNSERIALIZERPTR pData);
@@ -61,6 +123,12 @@ PNSERIALIZER_API int64_t PnReadInt64(PNSERIALIZERPTR pData);
 PNSERIALIZER_API float   PnReadFloat32(PNSERIALIZERPTR pData);
 PNSERIALIZER_API double  PnReadFloat64(PNSERIALIZERPTR pData);
 
+PNSERIALIZER_API void    PnReadInt16Array(PNSERIALIZERPTR pData, int16_t** pValues, uint32_t* pCount);
+PNSERIALIZER_API void    PnReadInt32Array(PNSERIALIZERPTR pData, int32_t** pValues, uint32_t* pCount);
+PNSERIALIZER_API void    PnReadInt64Array(PNSERIALIZERPTR pData, int64_t** pValues, uint32_t* pCount);
+PNSERIALIZER_API void    PnReadFloat32Array(PNSERIALIZERPTR pData, float** pValues, uint32_t* pCount);
+PNSERIALIZER_API void    PnReadFloat64Array(PNSERIALIZERPTR pData, double** pValues, uint32_t* pCount);
+
 
 #ifdef __cplusplus
 }
@@ -69,88 +137,1284 @@ PNSERIALIZER_API double  PnReadFloat64(PNSERIALIZERPTR pData);
 
 #ifdef PN_SERIALIZER_IMPLEMENTATION
 
+#ifdef _WIN32
+  #include <windows.h>
+#else
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <fcntl.h>
+  #include <unistd.h>
+#endif // _WIN32
+
+/* Little-endian loads and stores; memcpy keeps them unaligned-safe and compiles to a single move */
+#ifdef PN_SER_LITTLE_ENDIAN
+  #define _PN_SER_LE16(x)  (x)
+  #define _PN_SER_LE32(x)  (x)
+  #define _PN_SER_LE64(x)  (x)
+#elif defined(_MSC_VER)
+  #define _PN_SER_LE16(x)  _byteswap_ushort(x)
+  #define _PN_SER_LE32(x)  _byteswap_ulong(x)
+  #define _PN_SER_LE64(x)  _byteswap_uint64(x)
+#elif defined(__GNUC__)
+  #define _PN_SER_LE16(x)  __builtin_bswap16(x)
+  #define _PN_SER_LE32(x)  __builtin_bswap32(x)
+  #define _PN_SER_LE64(x)  __builtin_bswap64(x)
+#else
+  #define _PN_SER_LE16(x)  ((uint16_t)(((x) >> 8) | ((x) << 8)))
+  #define _PN_SER_LE32(x)  ((((x) >> 24) & 0xFFu) | (((x) >> 8) & 0xFF00u) | (((x) << 8) & 0xFF0000u) | ((x) << 24))
+  #define _PN_SER_LE64(x)  (((uint64_t)_PN_SER_LE32((uint32_t)(x)) << 32) | _PN_SER_LE32((uint32_t)((x) >> 32)))
+#endif // PN_SER_LITTLE_ENDIAN
+
+static inline void _PnSer_Store16(void* p, uint16_t Value) { Value = _PN_SER_LE16(Value); memcpy(p, &Value, sizeof(Value)); }
+static inline void _PnSer_Store32(void* p, uint32_t Value) { Value = _PN_SER_LE32(Value); memcpy(p, &Value, sizeof(Value)); }
+static inline void _PnSer_Store64(void* p, uint64_t Value) { Value = _PN_SER_LE64(Value); memcpy(p, &Value, sizeof(Value)); }
+
+static inline uint16_t _PnSer_Load16(const void* p) { uint16_t Value; memcpy(&Value, p, sizeof(Value)); return _PN_SER_LE16(Value); }
+static inline uint32_t _PnSer_Load32(const void* p) { uint32_t Value; memcpy(&Value, p, sizeof(Value)); return _PN_SER_LE32(Value); }
+static inline uint64_t _PnSer_Load64(const void* p) { uint64_t Value; memcpy(&Value, p, sizeof(Value)); return _PN_SER_LE64(Value); }
+
+/* Sets the sticky PN_SER_ERROR, always returns 0 */
+static int _PnSer_Fail(PNSERIALIZERPTR pData)
+{
+    pData->Flags |= PN_SER_ERROR;
+    return 0;
+}
+
+/* fseek past 2GB, where "long" is 32 bits */
+static int _PnSer_Seek(FILE* pFile, int64_t Offset, int Origin)
+{
+#ifdef _WIN32
+    return _fseeki64(pFile, Offset, Origin) == 0;
+#else
+    return (int64_t)(long)Offset == Offset && fseek(pFile, (long)Offset, Origin) == 0;
+#endif // _WIN32
+}
+
+/**
+ * PN_SER_COMPRESS codec, LZ4-like: a block is a run of sequences, each a token byte (literal count in the
+ * high nibble, match length - 4 in the low one, 15 meaning "more bytes follow, 255 at a time"), the literals,
+ * then a 2-byte offset back into the last 64KB. The last sequence is literals only
+**/
+#define _PN_LZ_MINMATCH       4u
+#define _PN_LZ_HASHBITS       14u
+#define _PN_LZ_LASTLITERALS   5u   /* Matches end at least this far from the end of the block */
+#define _PN_LZ_MFLIMIT        12u  /* ... and start at least this far from it */
+#define _PN_LZ_MAXOFFSET      0xFFFFu
+
+static inline uint32_t _PnLz_Read32(const uint8_t* p) { uint32_t Value; memcpy(&Value, p, sizeof(Value)); return Value; }
+static inline uint64_t _PnLz_Read64(const uint8_t* p) { uint64_t Value; memcpy(&Value, p, sizeof(Value)); return Value; }
+
+static inline uint32_t _PnLz_Hash(uint32_t Sequence)
+{
+    return (Sequence * 2654435761u) >> (32u - _PN_LZ_HASHBITS);
+}
+
+/* Copies 8 bytes at a time, so it may write up to 7 bytes past "nBytes" (callers check there is room).
+   Also right for an overlapping match as long as the destination is at least 8 bytes past the source */
+static inline void _PnLz_WildCopy(uint8_t* pDst, const uint8_t* pSrc, size_t nBytes)
+{
+    uint8_t* pStop = pDst + nBytes;
+    do
+    {
+        memcpy(pDst, pSrc, sizeof(uint64_t));
+        pDst += sizeof(uint64_t);
+        pSrc += sizeof(uint64_t);
+    } while (pDst < pStop);
+}
+
+/* The bytes after a 15 nibble */
+static inline uint8_t* _PnLz_PutLength(uint8_t* p, uint32_t nLength)
+{
+    for (nLength -= 15u; nLength >= 255u; nLength -= 255u)
+        *p++ = 255u;
+    *p++ = (uint8_t)nLength;
+    return p;
+}
+
+static inline int _PnLz_GetLength(const uint8_t** pp, const uint8_t* pEnd, uint64_t* pLength)
+{
+    const uint8_t* p = *pp;
+    uint8_t Byte;
+
+    do
+    {
+        if (p == pEnd) return 0;
+        Byte = *p++;
+        *pLength += Byte;
+    } while (Byte == 255u);
+
+    *pp = p;
+    return 1;
+}
+
+static inline uint32_t _PnSer_Ctz64(uint64_t Mask)
+{
+#ifdef _MSC_VER
+    unsigned long Index;
+    _BitScanForward64(&Index, Mask);
+    return (uint32_t)Index;
+#elif defined(__GNUC__)
+    return (uint32_t)__builtin_ctzll(Mask);
+#else
+    uint32_t Index = 0;
+    while (!(Mask & 1u)) { Mask >>= 1; Index++; }
+    return Index;
+#endif // _MSC_VER
+}
+
+/* Greedy single-probe matcher into "pDst" (room for "nSrc" bytes). Returns the packed size, or 0 when the
+   result would not be smaller than the input, in which case the block is stored as is */
+static uint32_t _PnLz_Compress(const uint8_t* pSrc, uint32_t nSrc, uint8_t* pDst)
+{
+    uint32_t Table[1u << _PN_LZ_HASHBITS];
+    const uint8_t* p = pSrc;
+    const uint8_t* pAnchor = pSrc;
+    const uint8_t* pEnd = pSrc + nSrc;
+    const uint8_t* pLimit = nSrc > _PN_LZ_MFLIMIT ? pEnd - _PN_LZ_MFLIMIT : pSrc;
+    const uint8_t* pMax = nSrc > _PN_LZ_LASTLITERALS ? pEnd - _PN_LZ_LASTLITERALS : pSrc;
+    uint8_t* q = pDst;
+    uint8_t* qEnd = pDst + nSrc;
+    uint32_t nLiterals;
+
+    memset(Table, 0, sizeof(Table));
+
+    while (p < pLimit)
+    {
+        uint32_t Sequence = _PnLz_Read32(p), nMatch = _PN_LZ_MINMATCH, Hash = _PnLz_Hash(Sequence);
+        const uint8_t* pMatch = pSrc + Table[Hash];
+        uint8_t* pToken;
+
+        Table[Hash] = (uint32_t)(p - pSrc);
+        if (pMatch >= p || (uint32_t)(p - pMatch) > _PN_LZ_MAXOFFSET || _PnLz_Read32(pMatch) != Sequence)
+        {
+            /* Steps grow the longer nothing matches, incompressible data is skipped over quickly */
+            p += 1u + ((uint32_t)(p - pAnchor) >> 6);
+            continue;
+        }
+
+        /* Extend 8 bytes at a time, the first differing bit gives the exact length */
+        for (;;)
+        {
+#ifdef PN_SER_LITTLE_ENDIAN
+            if (pMax - (p + nMatch) >= 8)
+            {
+                uint64_t Diff = _PnLz_Read64(p + nMatch) ^ _PnLz_Read64(pMatch + nMatch);
+                if (Diff == 0) { nMatch += 8u; continue; }
+                nMatch += _PnSer_Ctz64(Diff) >> 3;
+                break;
+            }
+#endif // PN_SER_LITTLE_ENDIAN
+            if (p + nMatch < pMax && p[nMatch] == pMatch[nMatch]) { nMatch++; continue; }
+            break;
+        }
+
+        nLiterals = (uint32_t)(p - pAnchor);
+        if ((size_t)(qEnd - q) < (size_t)nLiterals + nLiterals / 255u + nMatch / 255u + 5u)
+            return 0;
+
+        pToken = q++;
+        *pToken = (uint8_t)((nLiterals >= 15u ? 15u : nLiterals) << 4);
+        if (nLiterals >= 15u) q = _PnLz_PutLength(q, nLiterals);
+        /* Matches start before "pLimit", reading 8 past the literals stays inside the block */
+        if ((size_t)(qEnd - q) >= (size_t)nLiterals + sizeof(uint64_t))
+            _PnLz_WildCopy(q, pAnchor, nLiterals);
+        else
+            memcpy(q, pAnchor, nLiterals);
+        q += nLiterals;
+
+        _PnSer_Store16(q, (uint16_t)(p - pMatch));
+        q += sizeof(uint16_t);
+
+        p += nMatch;
+        pAnchor = p;
+        nMatch -= _PN_LZ_MINMATCH;
+        *pToken |= (uint8_t)(nMatch >= 15u ? 15u : nMatch);
+        if (nMatch >= 15u) q = _PnLz_PutLength(q, nMatch);
+    }
+
+    nLiterals = (uint32_t)(pEnd - pAnchor);
+    if ((size_t)(qEnd - q) <= (size_t)nLiterals + nLiterals / 255u + 2u)
+        return 0;
+
+    *q = (uint8_t)((nLiterals >= 15u ? 15u : nLiterals) << 4);
+    q = nLiterals >= 15u ? _PnLz_PutLength(q + 1, nLiterals) : q + 1;
+    memcpy(q, pAnchor, nLiterals);
+    q += nLiterals;
+
+    return (uint32_t)(q - pDst);
+}
+
+/* Unpacks exactly "nDst" bytes, 0 on anything malformed. The input comes from a file, so every length and
+   offset is checked before it is used */
+static int _PnLz_Decompress(const uint8_t* pSrc, uint32_t nSrc, uint8_t* pDst, uint32_t nDst)
+{
+    const uint8_t* p = pSrc;
+    const uint8_t* pEnd = pSrc + nSrc;
+    uint8_t* q = pDst;
+    uint8_t* qEnd = pDst + nDst;
+
+    while (p < pEnd)
+    {
+        uint32_t Token = *p++;
+        uint64_t nLiterals = Token >> 4, nMatch = Token & 15u, Offset;
+
+        if (nLiterals == 15u && !_PnLz_GetLength(&p, pEnd, &nLiterals)) return 0;
+        if (nLiterals > (uint64_t)(pEnd - p) || nLiterals > (uint64_t)(qEnd - q)) return 0;
+
+        if ((uint64_t)(pEnd - p) >= nLiterals + sizeof(uint64_t) && (uint64_t)(qEnd - q) >= nLiterals + sizeof(uint64_t))
+            _PnLz_WildCopy(q, p, (size_t)nLiterals);
+        else
+            memcpy(q, p, (size_t)nLiterals);
+        p += nLiterals;
+        q += nLiterals;
+        if (p == pEnd) break;
+
+        if (pEnd - p < 2) return 0;
+        Offset = _PnSer_Load16(p);
+        p += sizeof(uint16_t);
+
+        if (nMatch == 15u && !_PnLz_GetLength(&p, pEnd, &nMatch)) return 0;
+        nMatch += _PN_LZ_MINMATCH;
+        if (Offset == 0 || Offset > (uint64_t)(q - pDst) || nMatch > (uint64_t)(qEnd - q)) return 0;
+
+        if (Offset >= sizeof(uint64_t) && (uint64_t)(qEnd - q) >= nMatch + sizeof(uint64_t))
+            _PnLz_WildCopy(q, q - Offset, (size_t)nMatch);
+        else if (Offset >= nMatch)
+            memcpy(q, q - Offset, (size_t)nMatch);
+        else
+        {
+            /* Overlapping match repeats the last "Offset" bytes, it has to go forwards byte by byte */
+            const uint8_t* pMatch = q - Offset;
+            uint64_t k;
+            for (k = 0; k < nMatch; k++) q[k] = pMatch[k];
+        }
+        q += nMatch;
+    }
+
+    return q == qEnd;
+}
+
+/* Per-block checksum of the raw bytes, 8 at a time */
+static uint32_t _PnSer_Checksum(const char* p, uint32_t nBytes)
+{
+    uint64_t Hash = 0x9E3779B97F4A7C15ULL ^ nBytes;
+
+    for (; nBytes >= sizeof(uint64_t); nBytes -= sizeof(uint64_t), p += sizeof(uint64_t))
+    {
+        Hash ^= _PnSer_Load64(p) * 0xC2B2AE3D27D4EB4FULL;
+        Hash = ((Hash << 31) | (Hash >> 33)) * 0x9E3779B97F4A7C15ULL;
+    }
+    while (nBytes--)
+        Hash = (Hash ^ (uint8_t)*p++) * 0x100000001B3ULL;
+
+    Hash ^= Hash >> 33;
+    Hash *= 0xFF51AFD7ED558CCDULL;
+    Hash ^= Hash >> 33;
+
+    return (uint32_t)Hash;
+}
+
+/* A block on disk: raw size, packed size (top bit set when stored unpacked), checksum, then the bytes */
+#define _PN_SER_BLOCK_HEADER  (3u * sizeof(uint32_t))
+#define _PN_SER_BLOCK_STORED  0x80000000u
+/* Last in the file: offset of the block index, payload length, block count, block size */
+#define _PN_SER_FOOTER        (2u * sizeof(uint64_t) + 2u * sizeof(uint32_t))
+/* Blocks handed to the codec at once, bounds the scratch memory of a large buffered PnSerializationEnd */
+#define _PN_SER_BATCH         (4u * PN_SERIALIZER_THREADS)
+
+typedef struct
+{
+    const char* pIn;      /* Pack: raw bytes; unpack: packed bytes */
+    char*       pOut;     /* Pack: scratch of "nIn" bytes; unpack: where the raw bytes go */
+    uint32_t    nIn;
+    uint32_t    nOut;     /* Pack: packed size; unpack: expected raw size */
+    uint32_t    Checksum;
+    int         Stored;
+} PNSERBLOCK;
+
+typedef int (pfn_SerBlock)(PNSERBLOCK* pBlock);
+
+static int _PnSer_PackBlock(PNSERBLOCK* pBlock)
+{
+    pBlock->Checksum = _PnSer_Checksum(pBlock->pIn, pBlock->nIn);
+    pBlock->nOut = _PnLz_Compress((const uint8_t*)pBlock->pIn, pBlock->nIn, (uint8_t*)pBlock->pOut);
+    pBlock->Stored = pBlock->nOut == 0;
+    if (pBlock->Stored) pBlock->nOut = pBlock->nIn;
+    return 1;
+}
+
+static int _PnSer_UnpackBlock(PNSERBLOCK* pBlock)
+{
+    if (pBlock->Stored)
+    {
+        if (pBlock->nIn != pBlock->nOut) return 0;
+        memcpy(pBlock->pOut, pBlock->pIn, pBlock->nIn);
+    }
+    else if (!_PnLz_Decompress((const uint8_t*)pBlock->pIn, pBlock->nIn, (uint8_t*)pBlock->pOut, pBlock->nOut))
+        return 0;
+
+    return _PnSer_Checksum(pBlock->pOut, pBlock->nOut) == pBlock->Checksum;
+}
+
+#ifdef PN_SER_THREADS
+/* Thread shim for the block codec */
+#ifdef _WIN32
+  typedef HANDLE PNSERTHREAD;
+  #define PN_SER_THREAD_PROC(Name, pArg)           static DWORD WINAPI Name(LPVOID pArg)
+  #define PN_SER_THREAD_RETURN                     0
+  #define _PnSerThread_Start(pThread, Proc, pArg)  ((*(pThread) = CreateThread(NULL, 0, Proc, pArg, 0, NULL)) != NULL)
+  #define _PnSerThread_Join(Thread)                (WaitForSingleObject(Thread, INFINITE), CloseHandle(Thread))
+#else
+  #include <pthread.h>
+  typedef pthread_t PNSERTHREAD;
+  #define PN_SER_THREAD_PROC(Name, pArg)           static void* Name(void* pArg)
+  #define PN_SER_THREAD_RETURN                     NULL
+  #define _PnSerThread_Start(pThread, Proc, pArg)  (pthread_create(pThread, NULL, Proc, pArg) == 0)
+  #define _PnSerThread_Join(Thread)                pthread_join(Thread, NULL)
+#endif // _WIN32
+
+typedef struct
+{
+    PNSERBLOCK*   pBlocks;
+    uint32_t      First;
+    uint32_t      Step;
+    uint32_t      nBlocks;
+    pfn_SerBlock* Proc;
+    int           Result;
+    PNSERTHREAD   Thread;
+    int           Started;
+} PNSERBLOCKJOB;
+
+PN_SER_THREAD_PROC(_PnSer_BlockJob, pArg)
+{
+    PNSERBLOCKJOB* pJob = (PNSERBLOCKJOB*)pArg;
+    uint32_t k;
+
+    for (k = pJob->First; k < pJob->nBlocks; k += pJob->Step)
+        pJob->Result = pJob->Proc(&pJob->pBlocks[k]) && pJob->Result;
+    return PN_SER_THREAD_RETURN;
+}
+#endif // PN_SER_THREADS
+
+/* Runs "Proc" over every block, spread over up to PN_SERIALIZER_THREADS threads in PN_SER_THREADS builds;
+   returns 0 if any block failed */
+static int _PnSer_RunBlocks(PNSERBLOCK* pBlocks, uint32_t nBlocks, pfn_SerBlock* Proc)
+{
+    int Result = 1;
+    uint32_t k;
+
+#ifdef PN_SER_THREADS
+    PNSERBLOCKJOB Jobs[PN_SERIALIZER_THREADS];
+    uint32_t nThreads = nBlocks < PN_SERIALIZER_THREADS ? nBlocks : PN_SERIALIZER_THREADS;
+
+    if (nThreads > 1u)
+    {
+        /* Blocks are dealt out round robin, they are all the same size */
+        for (k = 0; k < nThreads; k++)
+        {
+            Jobs[k].pBlocks = pBlocks;
+            Jobs[k].First = k;
+            Jobs[k].Step = nThreads;
+            Jobs[k].nBlocks = nBlocks;
+            Jobs[k].Proc = Proc;
+            Jobs[k].Result = 1;
+            Jobs[k].Started = k != 0 && _PnSerThread_Start(&Jobs[k].Thread, &_PnSer_BlockJob, &Jobs[k]);
+        }
+
+        /* The calling thread takes the first share, and any share whose thread failed to start */
+        for (k = 0; k < nThreads; k++)
+            if (!Jobs[k].Started)
+                _PnSer_BlockJob(&Jobs[k]);
+
+        for (k = 0; k < nThreads; k++)
+        {
+            if (Jobs[k].Started)
+                _PnSerThread_Join(Jobs[k].Thread);
+            Result = Jobs[k].Result && Result;
+        }
+        return Result;
+    }
+#endif // PN_SER_THREADS
+
+    for (k = 0; k < nBlocks; k++)
+        Result = Proc(&pBlocks[k]) && Result;
+    return Result;
+}
+
+/* Streams and compressed output put the header off until the first write to the file, so
+   PnSerializerSetFlags can still pick the format after the Begin call */
+static int _PnSer_PutHeader(PNSERIALIZERPTR pData)
+{
+    char FullSize[sizeof(uint32_t)];
+
+    _PnSer_Store32(FullSize, (pData->Flags & PN_SER_COMPRESS) ? PN_SERIALIZER_COMPRESSED : PN_SERIALIZER_STREAMED);
+    if (fwrite(FullSize, sizeof(uint32_t), 1U, pData->pFile) != 1U)
+        return 0;
+
+    pData->Written = sizeof(uint32_t);
+    return 1;
+}
+
+/* PN_SER_COMPRESS: packs and writes the whole blocks in "pBuffer" (and the short last one when "Final"),
+   then moves what is left to the front */
+static int _PnSer_PutBlocks(PNSERIALIZERPTR pData, int Final)
+{
+    uint32_t nBlocks = Final ? (uint32_t)(((uint64_t)pData->Size + PN_SERIALIZER_BLOCK - 1u) / PN_SERIALIZER_BLOCK)
+                             : pData->Size / PN_SERIALIZER_BLOCK;
+    uint32_t Used = Final ? pData->Size : nBlocks * PN_SERIALIZER_BLOCK;
+    uint32_t nBatch = nBlocks < _PN_SER_BATCH ? nBlocks : _PN_SER_BATCH;
+    uint32_t k, j;
+    PNSERBLOCK* pBlocks;
+    char* pScratch;
+    int Result = 1;
+
+    if (nBlocks == 0) return 1;
+
+    if (nBlocks > pData->_IndexCap - pData->nBlocks)
+    {
+        uint64_t NewCap = pData->_IndexCap ? (uint64_t)pData->_IndexCap * 2u : 64u;
+        uint64_t* pIndex;
+
+        while (NewCap < (uint64_t)pData->nBlocks + nBlocks) NewCap *= 2u;
+        if (NewCap > UINT32_MAX) return 0;
+
+        pIndex = (uint64_t*)realloc(pData->pIndex, (size_t)NewCap * sizeof(uint64_t));
+        if (pIndex == NULL) return 0;
+        pData->pIndex = pIndex;
+        pData->_IndexCap = (uint32_t)NewCap;
+    }
+
+    pBlocks = (PNSERBLOCK*)malloc(nBatch * sizeof(PNSERBLOCK));
+    pScratch = (char*)malloc((size_t)nBatch * PN_SERIALIZER_BLOCK);
+
+    for (k = 0; k < nBlocks && Result && pBlocks && pScratch; k += nBatch)
+    {
+        uint32_t nRun = nBlocks - k < nBatch ? nBlocks - k : nBatch;
+
+        for (j = 0; j < nRun; j++)
+        {
+            uint32_t Start = (k + j) * PN_SERIALIZER_BLOCK;
+            pBlocks[j].pIn = pData->pBuffer + Start;
+            pBlocks[j].nIn = Used - Start < PN_SERIALIZER_BLOCK ? Used - Start : PN_SERIALIZER_BLOCK;
+            pBlocks[j].pOut = pScratch + (size_t)j * PN_SERIALIZER_BLOCK;
+        }
+        _PnSer_RunBlocks(pBlocks, nRun, &_PnSer_PackBlock);
+
+        /* Written in order whatever order they were packed in */
+        for (j = 0; j < nRun && Result; j++)
+        {
+            const PNSERBLOCK* pBlock = &pBlocks[j];
+            char Header[_PN_SER_BLOCK_HEADER];
+
+            _PnSer_Store32(Header, pBlock->nIn);
+            _PnSer_Store32(Header + sizeof(uint32_t), pBlock->nOut | (pBlock->Stored ? _PN_SER_BLOCK_STORED : 0u));
+            _PnSer_Store32(Header + 2u * sizeof(uint32_t), pBlock->Checksum);
+
+            Result = fwrite(Header, sizeof(Header), 1U, pData->pFile) == 1U &&
+                     fwrite(pBlock->Stored ? pBlock->pIn : pBlock->pOut, sizeof(char), pBlock->nOut, pData->pFile) == pBlock->nOut;
+
+            pData->pIndex[pData->nBlocks++] = pData->Written;
+            pData->Written += sizeof(Header) + pBlock->nOut;
+        }
+    }
+
+    Result = Result && pBlocks && pScratch;
+    free(pBlocks);
+    free(pScratch);
+    if (!Result) return 0;
+
+    memmove(pData->pBuffer, pData->pBuffer + Used, pData->Size - Used);
+    pData->Flushed += Used;
+    pData->Size -= Used;
+    pData->pPos = pData->pBuffer + pData->Size;
+
+    return 1;
+}
+
+/* Streams end on the 64-bit payload length; compressed output on the block index and the footer */
+static int _PnSer_PutTrailer(PNSERIALIZERPTR pData)
+{
+    char Footer[_PN_SER_FOOTER];
+    uint32_t k;
+
+    if (!(pData->Flags & PN_SER_COMPRESS))
+    {
+        _PnSer_Store64(Footer, pData->Flushed);
+        return fwrite(Footer, sizeof(uint64_t), 1U, pData->pFile) == 1U;
+    }
+
+    /* The index is not needed after this, it goes out converted in place */
+    for (k = 0; k < pData->nBlocks; k++)
+        _PnSer_Store64(&pData->pIndex[k], pData->pIndex[k]);
+
+    _PnSer_Store64(Footer, pData->Written);
+    _PnSer_Store64(Footer + sizeof(uint64_t), pData->Flushed);
+    _PnSer_Store32(Footer + 2u * sizeof(uint64_t), pData->nBlocks);
+    _PnSer_Store32(Footer + 2u * sizeof(uint64_t) + sizeof(uint32_t), PN_SERIALIZER_BLOCK);
+
+    return (pData->nBlocks == 0 || fwrite(pData->pIndex, sizeof(uint64_t), pData->nBlocks, pData->pFile) == pData->nBlocks) &&
+           fwrite(Footer, sizeof(Footer), 1U, pData->pFile) == 1U;
+}
+
+/* PN_SER_STREAM: writes out and empties "pBuffer". Under PN_SER_COMPRESS only whole blocks go out,
+   unless it is the "Final" flush */
+static int _PnSer_Flush(PNSERIALIZERPTR pData, int Final)
+{
+    if (pData->Written == 0 && !_PnSer_PutHeader(pData))
+        return 0;
+    if (pData->Flags & PN_SER_COMPRESS)
+        return _PnSer_PutBlocks(pData, Final);
+
+    if (pData->Size && fwrite(pData->pBuffer, sizeof(char), pData->Size, pData->pFile) != pData->Size)
+        return 0;
+
+    pData->Flushed += pData->Size;
+    pData->Written += pData->Size;
+    pData->Size = 0UL;
+    pData->pPos = pData->pBuffer;
+
+    return 1;
+}
+
+/* Grows "pBuffer" (doubling) so that "nBytes" more fit, returns 0 if that is not possible.
+   Streams flush first and only grow for a single value bigger than the whole chunk */
+static int _PnSer_Grow(PNSERIALIZERPTR pData, uint32_t nBytes)
+{
+    uint64_t Needed, NewCap, Limit = PN_SERIALIZER_MAXSIZE;
+    char* pBuffer;
+
+    /* A stream's buffer only ever holds one chunk, its length never goes into the header */
+    if (pData->Flags & PN_SER_STREAM)
+    {
+        if (!_PnSer_Flush(pData, 0)) return _PnSer_Fail(pData);
+        if (pData->_Cap - pData->Size >= nBytes) return 1;
+        Limit = UINT32_MAX;
+    }
+
+    Needed = (uint64_t)pData->Size + nBytes;
+    NewCap = pData->_Cap ? pData->_Cap : PN_SERIALIZER_BUFSIZE;
+
+    if (Needed > Limit) return _PnSer_Fail(pData);
+    while (NewCap < Needed) NewCap *= 2;
+    if (NewCap > Limit) NewCap = Limit;
+
+    pBuffer = (char*)realloc(pData->pBuffer, (size_t)NewCap);
+    if (pBuffer == NULL) return _PnSer_Fail(pData);
+
+    pData->pBuffer = pBuffer;
+    pData->pPos  = pBuffer + pData->Size;
+    pData->_Cap  = (uint32_t)NewCap;
+
+    return 1;
+}
+
+/* Every write checks before touching the buffer, the realloc is out of line */
+static inline int _PnSer_Ensure(PNSERIALIZERPTR pData, uint32_t nBytes)
+{
+    return pData->_Cap - pData->Size >= nBytes || _PnSer_Grow(pData, nBytes);
+}
+
+/* Readers: a single "remaining >= n" compare per field. Running short sets the sticky PN_SER_ERROR and parks
+   "pPos" at the end, so the field and everything after it reads as zero/empty and nothing past the data is touched */
+static inline int _PnSer_Need(PNSERIALIZERPTR pData, uint64_t nBytes)
+{
+    if (PN_SER_LIKELY((uint64_t)(pData->pEnd - pData->pPos) >= nBytes)) return 1;
+
+    pData->pPos = pData->pEnd;
+    return _PnSer_Fail(pData);
+}
+
+/* PN_SER_VARINT: 7 bits per byte, low group first, top bit set on all but the last byte */
+#define _PN_SER_VARINT_MAX  10u
+
+static inline uint64_t _PnSer_ZigZag(int64_t Value)
+{
+    return ((uint64_t)Value << 1) ^ (uint64_t)(Value >> 63);
+}
+
+static inline int64_t _PnSer_UnZigZag(uint64_t Value)
+{
+    return (int64_t)(Value >> 1) ^ -(int64_t)(Value & 1);
+}
+
+static void _PnSer_PutVarint(PNSERIALIZERPTR pData, uint64_t Value)
+{
+    uint8_t* p;
+    if (!_PnSer_Ensure(pData, _PN_SER_VARINT_MAX)) return;
+
+    p = (uint8_t*)pData->pPos;
+    while (Value >= 0x80)
+    {
+        *p++ = (uint8_t)(Value | 0x80);
+        Value >>= 7;
+    }
+    *p++ = (uint8_t)Value;
+
+    pData->Size += (uint32_t)(p - (uint8_t*)pData->pPos);
+    pData->pPos = (char*)p;
+    return;
+}
+
+/* Multi-byte values, kept out of line so the readers only inline the single byte case */
+static uint64_t _PnSer_GetVarintLong(PNSERIALIZERPTR pData)
+{
+    const uint8_t* p = (const uint8_t*)pData->pPos;
+    const uint8_t* pEnd = (const uint8_t*)pData->pEnd;
+    uint64_t Value = 0;
+    uint32_t Shift = 0;
+
+#ifdef PN_SER_LITTLE_ENDIAN
+    /* Up to 8 bytes at once: the first clear top bit ends the value, then the 7-bit groups are
+       packed together with fixed shifts instead of a loop */
+    if (pEnd - p >= 8)
+    {
+        uint64_t Word, Stop;
+        memcpy(&Word, p, sizeof(uint64_t));
+        Stop = ~Word & 0x8080808080808080ULL;
+
+        if (Stop != 0)
+        {
+            Stop &= 0ULL - Stop;
+            Word &= (Stop << 1) - 1;
+
+            Value = (Word & 0x7FULL)
+                  | ((Word >> 1) & (0x7FULL << 7))  | ((Word >> 2) & (0x7FULL << 14))
+                  | ((Word >> 3) & (0x7FULL << 21)) | ((Word >> 4) & (0x7FULL << 28))
+                  | ((Word >> 5) & (0x7FULL << 35)) | ((Word >> 6) & (0x7FULL << 42))
+                  | ((Word >> 7) & (0x7FULL << 49));
+            pData->pPos += (_PnSer_Ctz64(Stop) + 1) / 8;
+            return Value;
+        }
+    }
+#endif // PN_SER_LITTLE_ENDIAN
+
+    while (p < pEnd && Shift < 64)
+    {
+        Value |= (uint64_t)(*p & 0x7F) << Shift;
+        Shift += 7;
+        if (!(*p++ & 0x80))
+        {
+            pData->pPos = (char*)p;
+            return Value;
+        }
+    }
+
+    /* Ran off the end, or more than 10 bytes */
+    pData->pPos = pData->pEnd;
+    return _PnSer_Fail(pData);
+}
+
+static inline uint64_t _PnSer_GetVarint(PNSERIALIZERPTR pData)
+{
+    const uint8_t* p = (const uint8_t*)pData->pPos;
+
+    if (PN_SER_LIKELY(p < (const uint8_t*)pData->pEnd && p[0] < 0x80))
+    {
+        pData->pPos++;
+        return p[0];
+    }
+
+    return _PnSer_GetVarintLong(pData);
+}
+
+/* Length prefixes: "Fixed" bytes (2 or 4) normally, an unsigned varint in PN_SER_VARINT mode */
+static void _PnSer_PutLength(PNSERIALIZERPTR pData, uint32_t nLength, uint32_t Fixed)
+{
+    if (pData->Flags & PN_SER_VARINT)
+        _PnSer_PutVarint(pData, nLength);
+    else if (Fixed == sizeof(int16_t))
+        PnWriteInt16(pData, (int16_t)nLength);
+    else
+        PnWriteInt32(pData, (int32_t)nLength);
+    return;
+}
+
+static int32_t _PnSer_GetLength(PNSERIALIZERPTR pData, uint32_t Fixed)
+{
+    if (pData->Flags & PN_SER_VARINT)
+    {
+        /* No writer produces more than INT32_MAX, a bigger value is corrupt and must not wrap to a small one */
+        uint64_t nLength = _PnSer_GetVarint(pData);
+        if (PN_SER_LIKELY(nLength <= INT32_MAX)) return (int32_t)nLength;
+
+        pData->pPos = pData->pEnd;
+        return _PnSer_Fail(pData);
+    }
+    return Fixed == sizeof(int16_t) ? PnReadInt16(pData) : PnReadInt32(pData);
+}
+
+/* Raw bytes after a length prefix; in a stream anything over half a chunk skips the chunk buffer,
+   or goes through it a chunk at a time when it has to be packed into blocks */
+static void _PnSer_PutRaw(PNSERIALIZERPTR pData, const void* pBytes, uint32_t nBytes)
+{
+    if ((pData->Flags & PN_SER_STREAM) && nBytes > pData->_Cap / 2)
+    {
+        const char* p = (const char*)pBytes;
+
+        if (!(pData->Flags & PN_SER_COMPRESS))
+        {
+            if (_PnSer_Flush(pData, 0) && fwrite(pBytes, sizeof(char), nBytes, pData->pFile) == nBytes)
+            {
+                pData->Flushed += nBytes;
+                pData->Written += nBytes;
+            }
+            else
+                _PnSer_Fail(pData);
+            return;
+        }
+
+        while (nBytes > pData->_Cap - pData->Size)
+        {
+            uint32_t nPiece = pData->_Cap - pData->Size;
+
+            memcpy(pData->pPos, p, nPiece);
+            pData->pPos += nPiece;
+            pData->Size += nPiece;
+            p += nPiece;
+            nBytes -= nPiece;
+
+            if (!_PnSer_Flush(pData, 0)) { _PnSer_Fail(pData); return; }
+            if (pData->Size == pData->_Cap) break; /* Chunk smaller than a block, the rest grows it */
+        }
+        pBytes = p;
+    }
+
+    if (!_PnSer_Ensure(pData, nBytes)) return;
+
+    memcpy(pData->pPos, pBytes, nBytes);
+    pData->pPos += nBytes;
+    pData->Size += nBytes;
+
+    return;
+}
+
+#ifndef PN_SER_LITTLE_ENDIAN
+/* Big-endian hosts only: wire order <-> host order in place, plain loops the compiler can vectorise */
+static void _PnSer_SwapArray(void* pValues, uint32_t nCount, uint32_t Width)
+{
+    char* p = (char*)pValues;
+    uint32_t k;
+
+    switch (Width)
+    {
+    case sizeof(uint16_t):
+        for (k = 0; k < nCount; k++, p += Width) { uint16_t v = _PnSer_Load16(p); memcpy(p, &v, Width); }
+        break;
+    case sizeof(uint32_t):
+        for (k = 0; k < nCount; k++, p += Width) { uint32_t v = _PnSer_Load32(p); memcpy(p, &v, Width); }
+        break;
+    default:
+        for (k = 0; k < nCount; k++, p += Width) { uint64_t v = _PnSer_Load64(p); memcpy(p, &v, Width); }
+        break;
+    }
+
+    return;
+}
+#endif // PN_SER_LITTLE_ENDIAN
+
+/* Arrays: an element count, then the elements back to back (zigzag varints for integers in PN_SER_VARINT mode) */
+static void _PnSer_WriteArray(PNSERIALIZERPTR pData, const void* pValues, uint32_t nCount, uint32_t Width, int Integer)
+{
+    uint64_t nBytes = (uint64_t)nCount * Width;
+    uint32_t k;
+
+    if (nBytes > UINT32_MAX) { _PnSer_Fail(pData); return; }
+    _PnSer_PutLength(pData, nCount, sizeof(int32_t));
+
+    if (!Integer || !(pData->Flags & PN_SER_VARINT))
+    {
+#ifdef PN_SER_LITTLE_ENDIAN
+        _PnSer_PutRaw(pData, pValues, (uint32_t)nBytes);
+#else
+        /* Copy a buffer's worth at a time and swap it in place there, the caller's array is const */
+        const char* p = (const char*)pValues;
+        for (k = 0; k < nCount; )
+        {
+            uint32_t nBlock = pData->_Cap / Width > 0 ? pData->_Cap / Width : 1;
+            if (nBlock > nCount - k) nBlock = nCount - k;
+            if (!_PnSer_Ensure(pData, nBlock * Width)) return;
+
+            memcpy(pData->pPos, p, (size_t)nBlock * Width);
+            _PnSer_SwapArray(pData->pPos, nBlock, Width);
+            pData->pPos += nBlock * Width;
+            pData->Size += nBlock * Width;
+            p += (size_t)nBlock * Width;
+            k += nBlock;
+        }
+#endif // PN_SER_LITTLE_ENDIAN
+        return;
+    }
+
+    /* Width is only ever 2, 4 or 8, the switch stays outside the loops */
+    switch (Width)
+    {
+    case sizeof(int16_t):
+        for (k = 0; k < nCount; k++) _PnSer_PutVarint(pData, _PnSer_ZigZag(((const int16_t*)pValues)[k]));
+        break;
+    case sizeof(int32_t):
+        for (k = 0; k < nCount; k++) _PnSer_PutVarint(pData, _PnSer_ZigZag(((const int32_t*)pValues)[k]));
+        break;
+    default:
+        for (k = 0; k < nCount; k++) _PnSer_PutVarint(pData, _PnSer_ZigZag(((const int64_t*)pValues)[k]));
+        break;
+    }
+
+    return;
+}
+
+static void* _PnSer_ReadArray(PNSERIALIZERPTR pData, uint32_t Width, int Integer, uint32_t* pCount)
+{
+    uint32_t nCount = (uint32_t)_PnSer_GetLength(pData, sizeof(int32_t)), k;
+    int Varint = Integer && (pData->Flags & PN_SER_VARINT);
+    void* pValues;
+
+    /* Checked before the malloc, a corrupt count must not turn into a huge allocation (varints are >= 1 byte) */
+    if (pCount != NULL) *pCount = 0;
+    if (!_PnSer_Need(pData, Varint ? (uint64_t)nCount : (uint64_t)nCount * Width)) return NULL;
+
+    pValues = malloc((size_t)nCount * Width + 1);
+    if (pValues == NULL) { _PnSer_Fail(pData); return NULL; }
+    if (pCount != NULL) *pCount = nCount;
+
+    if (!Varint)
+    {
+        memcpy(pValues, pData->pPos, (size_t)nCount * Width);
+        pData->pPos += (size_t)nCount * Width;
+#ifndef PN_SER_LITTLE_ENDIAN
+        _PnSer_SwapArray(pValues, nCount, Width);
+#endif // PN_SER_LITTLE_ENDIAN
+        return pValues;
+    }
+
+    switch (Width)
+    {
+    case sizeof(int16_t):
+        for (k = 0; k < nCount; k++) ((int16_t*)pValues)[k] = (int16_t)_PnSer_UnZigZag(_PnSer_GetVarint(pData));
+        break;
+    case sizeof(int32_t):
+        for (k = 0; k < nCount; k++) ((int32_t*)pValues)[k] = (int32_t)_PnSer_UnZigZag(_PnSer_GetVarint(pData));
+        break;
+    default:
+        for (k = 0; k < nCount; k++) ((int64_t*)pValues)[k] = _PnSer_UnZigZag(_PnSer_GetVarint(pData));
+        break;
+    }
+
+    return pValues;
+}
+
 void PnSerializationBegin(PNSERIALIZERPTR pData)
 {
     pData->pBuffer = malloc(PN_SERIALIZER_BUFSIZE);
     pData->pPos  = pData->pBuffer;
     pData->pFile = NULL;
     pData->Size  = 0UL;
-    pData->_Cap  = PN_SERIALIZER_BUFSIZE;
+    pData->_Cap  = pData->pBuffer ? PN_SERIALIZER_BUFSIZE : 0UL;
+    pData->pEnd  = NULL;
+    pData->Flags = pData->pBuffer ? PN_SER_NONE : PN_SER_ERROR;
+    pData->Flushed = 0ULL;
+    pData->Written = 0ULL;
+    pData->pIndex = NULL;
+    pData->nBlocks = pData->_IndexCap = 0UL;
+
+    return;
+}
+
+/* Writes go straight through to "lpstrFilename" in PN_SERIALIZER_CHUNK pieces, so memory use stays
+   bounded whatever the total. The file's size header is PN_SERIALIZER_STREAMED and a 64-bit payload
+   length follows the data; finish with PnSerializationEnd (its filename is ignored) */
+int PnSerializationBeginStream(PNSERIALIZERPTR pData, const char* lpstrFilename)
+{
+    if (!pData || !lpstrFilename) return 0;
+
+    pData->pBuffer = malloc(PN_SERIALIZER_CHUNK);
+    pData->pPos  = pData->pBuffer;
+    pData->Size  = 0UL;
+    pData->_Cap  = PN_SERIALIZER_CHUNK;
+    pData->Flags = PN_SER_STREAM;
+    pData->Flushed = 0ULL;
+    pData->Written = 0ULL;
+    pData->pIndex = NULL;
+    pData->nBlocks = pData->_IndexCap = 0UL;
+    pData->pEnd  = NULL;
+    pData->pFile = pData->pBuffer ? fopen(lpstrFilename, "wb") : NULL;
+
+    if (pData->pFile == NULL)
+    {
+        free(pData->pBuffer);
+        pData->pBuffer = pData->pPos = NULL;
+        pData->pFile = NULL;
+        pData->_Cap  = 0UL;
+        return 0;
+    }
+
+    /* Chunks are already large, stdio buffering would only add a copy */
+    setvbuf(pData->pFile, NULL, _IONBF, 0);
 
+    return 1;
+}
+
+/* Only PN_SER_VARINT (after the Begin call on both the writing and the reading side) and PN_SER_COMPRESS
+   (writing side, before anything reached the file) can be changed by hand */
+static uint32_t _PnSer_UserFlags(PNSERIALIZERCPTR pData)
+{
+    return PN_SER_VARINT | (pData->Written == 0 ? PN_SER_COMPRESS : 0u);
+}
+
+/* Turns the given flags on, leaving the others as they are */
+void PnSerializerSetFlags(PNSERIALIZERPTR pData, uint32_t Flags)
+{
+    pData->Flags |= Flags & _PnSer_UserFlags(pData);
+    return;
+}
+
+/* Turns the given flags off, leaving the others as they are */
+void PnSerializerClearFlags(PNSERIALIZERPTR pData, uint32_t Flags)
+{
+    pData->Flags &= ~(Flags & _PnSer_UserFlags(pData));
     return;
 }
 
+/* Writing side: payload offset of the next write, to hand to PnDeserializationBeginRange later */
+uint64_t PnSerializerTell(PNSERIALIZERCPTR pData)
+{
+    return pData->Flushed + pData->Size;
+}
+
+/* Makes room for "Bytes" of serialized data in total, so a known-size payload costs a single allocation.
+   Streams keep their fixed chunk, so this does nothing for them */
+int PnSerializerReserve(PNSERIALIZERPTR pData, uint32_t Bytes)
+{
+    if (!pData) return 0;
+    if (Bytes <= pData->_Cap || (pData->Flags & PN_SER_STREAM)) return 1;
+
+    return _PnSer_Grow(pData, Bytes - pData->Size);
+}
+
 int PnSerializationEnd(PNSERIALIZERPTR pData, const char* lpstrFilename)
 {
     int8_t Result = 0;
     if (!pData || !pData->pBuffer) return Result;
 
-    pData->pFile = fopen(lpstrFilename, "wb");
+    if ((pData->Flags & PN_SER_COMPRESS) && !(pData->Flags & PN_SER_STREAM))
+        pData->pFile = fopen(lpstrFilename, "wb");
 
-    if (pData->pFile == NULL)
+    if (pData->Flags & (PN_SER_STREAM | PN_SER_COMPRESS))
+    {
+        /* Trailer: the payload length (or the block index), which did not fit or was not known up front */
+        if (pData->pFile != NULL)
+        {
+            Result = _PnSer_Flush(pData, 1) && _PnSer_PutTrailer(pData);
+            Result = fclose(pData->pFile) == 0 && Result;
+            Result = Result && !(pData->Flags & PN_SER_ERROR);
+        }
+    }
+    else if ((pData->pFile = fopen(lpstrFilename, "wb")) == NULL)
         Result = 0;
     else
     {
         /* First, write the size of the serialized data (useful when deserializing) */
-        const uint32_t FullSize = pData->Size + sizeof(uint32_t);
-        fwrite(&FullSize, sizeof(uint32_t), 1U, pData->pFile);
+        char FullSize[sizeof(uint32_t)];
+        _PnSer_Store32(FullSize, pData->Size + sizeof(uint32_t));
+        Result = fwrite(FullSize, sizeof(uint32_t), 1U, pData->pFile) == 1U;
 
-        fwrite(pData->pBuffer, pData->Size, sizeof(char), pData->pFile);
-        fclose(pData->pFile);
-        Result = 1;
+        Result = fwrite(pData->pBuffer, sizeof(char), pData->Size, pData->pFile) == pData->Size && Result;
+        Result = fclose(pData->pFile) == 0 && Result;
+        Result = Result && !(pData->Flags & PN_SER_ERROR);
     }
 
     free(pData->pBuffer);
+    free(pData->pIndex);
     pData->pBuffer = NULL;
+    pData->pIndex = NULL;
+    pData->nBlocks = pData->_IndexCap = 0UL;
     pData->pFile = NULL;
     pData->Size  = 0UL;
     pData->_Cap  = 0L;
+    pData->Written = pData->Flushed = 0ULL;
+    pData->Flags = PN_SER_NONE;
 
     return Result;
 }
 
+/* PN_SER_COMPRESS file: reads the footer and index, then only the blocks covering [Offset, Offset + Length)
+   and unpacks them into "pBuffer". Everything read from the file is checked before it sizes an allocation */
+static int _PnSer_LoadBlocks(PNSERIALIZERPTR pData, FILE* pFile, uint64_t Offset, uint64_t Length)
+{
+    char Footer[_PN_SER_FOOTER];
+    uint64_t IndexAt, Total, First, Last, Start, Stop, Raw, k;
+    uint32_t nBlocks, BlockSize, nRange;
+    char* pEntries = NULL;
+    char* pPacked = NULL;
+    PNSERBLOCK* pBlocks = NULL;
+    int Result = 0;
+
+    if (!_PnSer_Seek(pFile, -(int64_t)_PN_SER_FOOTER, SEEK_END) || fread(Footer, sizeof(Footer), 1UL, pFile) != 1UL)
+        return 0;
+
+    IndexAt = _PnSer_Load64(Footer);
+    Total = _PnSer_Load64(Footer + sizeof(uint64_t));
+    nBlocks = _PnSer_Load32(Footer + 2u * sizeof(uint64_t));
+    BlockSize = _PnSer_Load32(Footer + 2u * sizeof(uint64_t) + sizeof(uint32_t));
+
+    if (BlockSize == 0 || BlockSize >= _PN_SER_BLOCK_STORED || Offset > Total ||
+        (uint64_t)nBlocks != (Total + BlockSize - 1u) / BlockSize)
+        return 0;
+
+    if (Length > Total - Offset) Length = Total - Offset;
+    First = Offset / BlockSize;
+    Last = Length ? (Offset + Length - 1u) / BlockSize + 1u : First;
+    Raw = (Last * BlockSize < Total ? Last * BlockSize : Total) - First * BlockSize;
+    nRange = (uint32_t)(Last - First);
+
+    if (Raw >= PN_SERIALIZER_STREAMED || (pData->pBuffer = (char*)malloc((size_t)Raw + 1)) == NULL)
+        return 0;
+
+    pData->Size = pData->_Cap = (uint32_t)Raw;
+    pData->pPos = pData->pBuffer + (Length ? Offset - First * BlockSize : 0u);
+    pData->pEnd = pData->pPos + Length;
+    if (nRange == 0) return 1;
+
+    /* Index entries First..Last, where the one past the range (or the index itself) ends the packed bytes */
+    pEntries = (char*)malloc(((size_t)nRange + 1u) * sizeof(uint64_t));
+    pBlocks = (PNSERBLOCK*)malloc((size_t)nRange * sizeof(PNSERBLOCK));
+    if (pEntries == NULL || pBlocks == NULL ||
+        !_PnSer_Seek(pFile, (int64_t)(IndexAt + First * sizeof(uint64_t)), SEEK_SET) ||
+        fread(pEntries, sizeof(uint64_t), (size_t)nRange + (Last < nBlocks), pFile) != (size_t)nRange + (Last < nBlocks))
+    {
+        free(pEntries);
+        free(pBlocks);
+        return 0;
+    }
+    if (Last == nBlocks) _PnSer_Store64(pEntries + (size_t)nRange * sizeof(uint64_t), IndexAt);
+
+    Start = _PnSer_Load64(pEntries);
+    Stop = _PnSer_Load64(pEntries + (size_t)nRange * sizeof(uint64_t));
+
+    /* A block never packs bigger than raw plus its header */
+    if (Start < Stop && Stop <= IndexAt && Stop - Start <= Raw + (uint64_t)nRange * _PN_SER_BLOCK_HEADER &&
+        (pPacked = (char*)malloc((size_t)(Stop - Start))) != NULL &&
+        _PnSer_Seek(pFile, (int64_t)Start, SEEK_SET) && fread(pPacked, sizeof(char), (size_t)(Stop - Start), pFile) == Stop - Start)
+    {
+        Result = 1;
+        for (k = 0; k < nRange && Result; k++)
+        {
+            uint64_t At = _PnSer_Load64(pEntries + k * sizeof(uint64_t)) - Start;
+            uint64_t Expected = (First + k + 1u) * BlockSize < Total ? BlockSize : Total - (First + k) * BlockSize;
+            uint32_t Packed;
+
+            Result = Stop - Start >= _PN_SER_BLOCK_HEADER && At <= Stop - Start - _PN_SER_BLOCK_HEADER &&
+                     _PnSer_Load32(pPacked + At) == Expected;
+            if (!Result) break;
+
+            Packed = _PnSer_Load32(pPacked + At + sizeof(uint32_t));
+            pBlocks[k].pIn = pPacked + At + _PN_SER_BLOCK_HEADER;
+            pBlocks[k].nIn = Packed & ~_PN_SER_BLOCK_STORED;
+            pBlocks[k].pOut = pData->pBuffer + k * BlockSize;
+            pBlocks[k].nOut = (uint32_t)Expected;
+            pBlocks[k].Checksum = _PnSer_Load32(pPacked + At + 2u * sizeof(uint32_t));
+            pBlocks[k].Stored = (Packed & _PN_SER_BLOCK_STORED) != 0;
+            Result = pBlocks[k].nIn <= Stop - Start - _PN_SER_BLOCK_HEADER - At;
+        }
+
+        Result = Result && _PnSer_RunBlocks(pBlocks, nRange, &_PnSer_UnpackBlock);
+    }
+
+    free(pEntries);
+    free(pBlocks);
+    free(pPacked);
+    return Result;
+}
+
 int PnDeserializationBegin(PNSERIALIZERPTR pData, const char* lpstrFilename)
 {
+    return PnDeserializationBeginRange(pData, lpstrFilename, 0, UINT64_MAX);
+}
+
+/* Loads "Length" bytes of payload starting at "Offset" (a PnSerializerTell value from the writer), clipped to
+   the payload; reads stop at the end of that range. Compressed files only read and unpack the blocks covering it */
+int PnDeserializationBeginRange(PNSERIALIZERPTR pData, const char* lpstrFilename, uint64_t Offset, uint64_t Length)
+{
+    char FullSize[sizeof(uint32_t)];
+    uint64_t Payload = UINT64_MAX;
     int8_t Result = 0;
+    FILE* pFile;
+
     if (!pData || !lpstrFilename) return Result;
 
-    pData->pBuffer = NULL;
-    pData->pPos  = NULL;
-    pData->Size  = 0UL;
-    pData->_Cap  = 0UL;
-    pData->pFile = fopen(lpstrFilename, "rb");
+    memset(pData, 0, sizeof(PNSERIALIZER));
+    if ((pFile = fopen(lpstrFilename, "rb")) == NULL) return Result;
 
-    if (pData->pFile == NULL)
-        Result = 0;
+    if (fread(FullSize, sizeof(uint32_t), 1UL, pFile) == 1UL)
+        Payload = (uint64_t)_PnSer_Load32(FullSize) - sizeof(uint32_t);
+
+    if (Payload == PN_SERIALIZER_COMPRESSED - sizeof(uint32_t))
+        Result = _PnSer_LoadBlocks(pData, pFile, Offset, Length);
     else
     {
-        fread(&pData->Size, sizeof(uint32_t), 1UL, pData->pFile);
-
-        if (pData->Size == 0UL)
-            Result = 0;
-        else
+        if (Payload == PN_SERIALIZER_STREAMED - sizeof(uint32_t))
         {
-            pData->_Cap = pData->Size;
-            pData->pBuffer = malloc(pData->Size);
+            /* Streamed file: the length is in the trailer, and the range has to fit in memory to be loaded here */
+            char Trailer[sizeof(uint64_t)];
+            Payload = UINT64_MAX;
 
-            fread(pData->pBuffer, sizeof(char), pData->Size, pData->pFile);
-            pData->pPos = pData->pBuffer;
-            fclose(pData->pFile);
-            Result = 1;
+            if (_PnSer_Seek(pFile, -(int64_t)sizeof(uint64_t), SEEK_END) &&
+                fread(Trailer, sizeof(uint64_t), 1UL, pFile) == 1UL)
+                Payload = _PnSer_Load64(Trailer);
+        }
+
+        /* Size counts the loaded payload only, the header was never part of the buffer */
+        if (Payload != UINT64_MAX && Offset <= Payload)
+        {
+            if (Length > Payload - Offset) Length = Payload - Offset;
+
+            if (Length < PN_SERIALIZER_STREAMED && _PnSer_Seek(pFile, (int64_t)(sizeof(uint32_t) + Offset), SEEK_SET) &&
+                (pData->pBuffer = (char*)malloc((size_t)Length + 1)) != NULL)
+            {
+                pData->Size = pData->_Cap = (uint32_t)Length;
+                pData->pPos = pData->pBuffer;
+                pData->pEnd = pData->pBuffer + pData->Size;
+                Result = fread(pData->pBuffer, sizeof(char), pData->Size, pFile) == pData->Size;
+            }
         }
     }
+    fclose(pFile);
+
+    if (!Result)
+    {
+        free(pData->pBuffer);
+        memset(pData, 0, sizeof(PNSERIALIZER));
+    }
 
     return Result;
 }
 
+/* Maps the whole file read-only, NULL on failure */
+static void* _PnSer_Map(const char* lpstrFilename, size_t* pSize)
+{
+    void* pMapping = NULL;
+#ifdef _WIN32
+    HANDLE hFile, hMapping;
+    LARGE_INTEGER Size;
+
+    hFile = CreateFileA(lpstrFilename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    if (GetFileSizeEx(hFile, &Size) && Size.QuadPart >= (LONGLONG)sizeof(uint32_t))
+    {
+        hMapping = CreateFileMappingA(hFile, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (hMapping != NULL)
+        {
+            /* The view keeps the mapping alive after both handles are closed */
+            pMapping = MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(hMapping);
+            *pSize = (size_t)Size.QuadPart;
+        }
+    }
+    CloseHandle(hFile);
+#else
+    struct stat Info;
+    int Fd = open(lpstrFilename, O_RDONLY);
+    if (Fd < 0)
+        return NULL;
+
+    if (fstat(Fd, &Info) == 0 && Info.st_size >= (off_t)sizeof(uint32_t))
+    {
+        pMapping = mmap(NULL, (size_t)Info.st_size, PROT_READ, MAP_SHARED, Fd, 0);
+        if (pMapping == MAP_FAILED)
+            pMapping = NULL;
+        else
+            *pSize = (size_t)Info.st_size;
+    }
+    close(Fd);
+#endif // _WIN32
+
+    return pMapping;
+}
+
+static void _PnSer_Unmap(void* pMapping, size_t Size)
+{
+#ifdef _WIN32
+    (void)Size;
+    UnmapViewOfFile(pMapping);
+#else
+    munmap(pMapping, Size);
+#endif // _WIN32
+    return;
+}
+
+/* Reads straight out of a read-only mapping of the file instead of a malloc'd copy. Pair with
+   PnRead*View to get pointers into the file, valid until PnDeserializationEnd */
+int PnDeserializationBeginMapped(PNSERIALIZERPTR pData, const char* lpstrFilename)
+{
+    size_t MapSize = 0;
+    uint64_t Payload, Limit;
+    uint32_t FullSize;
+    char* pMapping;
+
+    if (!pData || !lpstrFilename) return 0;
+
+    memset(pData, 0, sizeof(PNSERIALIZER));
+    pMapping = (char*)_PnSer_Map(lpstrFilename, &MapSize);
+    if (pMapping == NULL) return 0;
+
+    FullSize = _PnSer_Load32(pMapping);
+    Limit = MapSize - sizeof(uint32_t);
+
+    /* Packed blocks have to be unpacked somewhere, that is the copying reader */
+    if (FullSize == PN_SERIALIZER_COMPRESSED)
+    {
+        _PnSer_Unmap(pMapping, MapSize);
+        return PnDeserializationBegin(pData, lpstrFilename);
+    }
+
+    if (FullSize == PN_SERIALIZER_STREAMED && MapSize >= sizeof(uint32_t) + sizeof(uint64_t))
+    {
+        Payload = _PnSer_Load64(pMapping + MapSize - sizeof(uint64_t));
+        Limit -= sizeof(uint64_t);
+    }
+    else if (FullSize != PN_SERIALIZER_STREAMED)
+        Payload = (uint64_t)FullSize - sizeof(uint32_t);
+    else
+        Payload = UINT64_MAX;
+
+    /* Truncated or not one of ours */
+    if (FullSize < sizeof(uint32_t) || Payload > Limit)
+    {
+        _PnSer_Unmap(pMapping, MapSize);
+        return 0;
+    }
+
+    pData->pMapping = pMapping;
+    pData->MapSize = MapSize;
+    pData->pBuffer = pMapping + sizeof(uint32_t);
+    pData->pPos  = pData->pBuffer;
+    pData->pEnd  = pData->pBuffer + Payload;
+    pData->Size  = Payload < UINT32_MAX ? (uint32_t)Payload : UINT32_MAX;
+    pData->Flags = PN_SER_MAPPED;
+
+    return 1;
+}
+
 // NOTE: Not sure if this passing an array of pointers to delete them is going to be a problem
+/* Returns 0 if any read ran past the data (PN_SER_ERROR), the one check callers need after a batch of reads */
 int PnDeserializationEnd(PNSERIALIZERPTR pData, void** pMemBlocks, int32_t nMemBlocks)
 {
+    int Result;
     if (!pData || !pData->pBuffer) return 0;
 
-    free(pData->pBuffer);
+    Result = !(pData->Flags & PN_SER_ERROR);
+
+    if (pData->Flags & PN_SER_MAPPED)
+        _PnSer_Unmap(pData->pMapping, pData->MapSize);
+    else
+        free(pData->pBuffer);
+    pData->pMapping = NULL;
+    pData->MapSize = 0;
+    pData->Flags = PN_SER_NONE;
     pData->pBuffer = NULL;
     pData->pPos = NULL;
+    pData->pEnd = NULL;
     pData->pFile = NULL;
     pData->Size  = 0UL;
     pData->_Cap = 0UL;
@@ -163,31 +1427,16 @@ int PnDeserializationEnd(PNSERIALIZERPTR pData, void** pMemBlocks, int32_t nMemB
                 free(pMemBlocks[k]);
     }
 
-    return 1;
+    return Result;
 }
 
 
-// NOTE: To prevent errors and crashes, increase the value of PN_SERIALIZER_BUFSIZE
-//       Calling PnWriteBytes with nSize too large, may cause the program to write to
-//       unallocated memory
 void PnWriteBytes(PNSERIALIZERPTR pData, const void* pBytes, int32_t nSize)
 {
-    PnWriteInt32(pData, nSize);
-
-    char* _p = (char*)pBytes;
-    uint32_t k;
-
-    for (k = 0; k < nSize; k++)
-        pData->pPos[k] = _p[k];
+    if (nSize < 0) { _PnSer_Fail(pData); return; }
 
-    pData->pPos += nSize;
-    pData->Size += nSize;
-
-    if (pData->Size >= pData->_Cap)
-    {
-        pData->_Cap += PN_SERIALIZER_BUFSIZE;
-        pData->pBuffer = realloc(pData->pBuffer, pData->_Cap);
-    }
+    _PnSer_PutLength(pData, (uint32_t)nSize, sizeof(int32_t));
+    _PnSer_PutRaw(pData, pBytes, (uint32_t)nSize);
 
     return;
 }
@@ -195,7 +1444,10 @@ void PnWriteBytes(PNSERIALIZERPTR pData, const void* pBytes, int32_t nSize)
 void PnWriteString(PNSERIALIZERPTR pData, const char* lpstrString, int32_t nLength)
 {
     if (nLength == -1L) nLength = strlen(lpstrString);
-    PnWriteInt16(pData, (int16_t)nLength); /* Useful for deserializing */
+    /* The fixed prefix is an int16, longer strings need PN_SER_VARINT (or PnWriteBytes) */
+    if (nLength < 0 || (nLength > INT16_MAX && !(pData->Flags & PN_SER_VARINT))) { _PnSer_Fail(pData); return; }
+    if (!_PnSer_Ensure(pData, _PN_SER_VARINT_MAX + (uint32_t)nLength)) return;
+    _PnSer_PutLength(pData, (uint32_t)nLength, sizeof(int16_t)); /* Useful for deserializing */
 
     pData->pPos = strncpy(pData->pPos, lpstrString, nLength);
     pData->pPos += nLength;
@@ -219,109 +1471,114 @@ void PnWriteDatetime(PNSERIALIZERPTR pData, const struct tm* pDatetime)
     return;
 }
 
+/* Fixed-width fields are little-endian on the wire: one unaligned store on LE hosts, plus a bswap on BE */
 void PnWriteInt16(PNSERIALIZERPTR pData, int16_t Value)
 {
-    union { int16_t I16; char I8[2]; } __u;
-    __u.I16 = Value;
-
-    pData->pPos[0] = __u.I8[0];
-    pData->pPos[1] = __u.I8[1];
+    if (pData->Flags & PN_SER_VARINT) { _PnSer_PutVarint(pData, _PnSer_ZigZag(Value)); return; }
+    if (!_PnSer_Ensure(pData, sizeof(int16_t))) return;
 
+    _PnSer_Store16(pData->pPos, (uint16_t)Value);
     pData->pPos += sizeof(int16_t);
     pData->Size += sizeof(int16_t);
 
-    if (pData->Size >= pData->_Cap)
-    {
-        pData->_Cap += PN_SERIALIZER_BUFSIZE;
-        pData->pBuffer = realloc(pData->pBuffer, pData->_Cap);
-    }
-
     return;
 }
 
 void PnWriteInt32(PNSERIALIZERPTR pData, int32_t Value)
 {
-    union { int32_t I32; char I8[4]; } __u;
-    __u.I32 = Value;
-
-    uint32_t k;
-    for (k = 0; k < 4; k++)
-        pData->pPos[k] = __u.I8[k];
+    if (pData->Flags & PN_SER_VARINT) { _PnSer_PutVarint(pData, _PnSer_ZigZag(Value)); return; }
+    if (!_PnSer_Ensure(pData, sizeof(int32_t))) return;
 
+    _PnSer_Store32(pData->pPos, (uint32_t)Value);
     pData->pPos += sizeof(int32_t);
     pData->Size += sizeof(int32_t);
 
-    if (pData->Size >= pData->_Cap)
-    {
-        pData->_Cap += PN_SERIALIZER_BUFSIZE;
-        pData->pBuffer = realloc(pData->pBuffer, pData->_Cap);
-    }
-
     return;
 }
 
 void PnWriteInt64(PNSERIALIZERPTR pData, int64_t Value)
 {
-    union { int64_t I64; int32_t I32[2]; } __u;
-    __u.I64 = Value;
+    if (pData->Flags & PN_SER_VARINT) { _PnSer_PutVarint(pData, _PnSer_ZigZag(Value)); return; }
+    if (!_PnSer_Ensure(pData, sizeof(int64_t))) return;
 
-    PnWriteInt32(pData, __u.I32[0]);
-    PnWriteInt32(pData, __u.I32[1]);
+    _PnSer_Store64(pData->pPos, (uint64_t)Value);
+    pData->pPos += sizeof(int64_t);
+    pData->Size += sizeof(int64_t);
 
     return;
 }
 
-// TODO: [WriteFloat32(...)] does not call realloc(...) on pData->pBuffer
 void PnWriteFloat32(PNSERIALIZERPTR pData, float Value)
 {
-    static const size_t Float32Size = sizeof(float);
+    uint32_t Bits;
+    if (!_PnSer_Ensure(pData, sizeof(float))) return;
 
-    union
-    {
-        float F32;
-        char FloatBytes[Float32Size];
-    } __u;
-    __u.F32 = Value;
+    memcpy(&Bits, &Value, sizeof(float));
+    _PnSer_Store32(pData->pPos, Bits);
+    pData->pPos += sizeof(float);
+    pData->Size += sizeof(float);
 
-    uint32_t k;
-    for (k = 0; k < Float32Size; k++)
-        pData->pPos[k] = __u.FloatBytes[k];
+    return;
+}
+
+void PnWriteFloat64(PNSERIALIZERPTR pData, double Value)
+{
+    uint64_t Bits;
+    if (!_PnSer_Ensure(pData, sizeof(double))) return;
 
-    pData->pPos += Float32Size;
-    pData->Size += Float32Size;
+    memcpy(&Bits, &Value, sizeof(double));
+    _PnSer_Store64(pData->pPos, Bits);
+    pData->pPos += sizeof(double);
+    pData->Size += sizeof(double);
 
     return;
 }
 
-// TODO: [WriteFloat64(...)] does not call realloc(...) on pData->pBuffer
-void PnWriteFloat64(PNSERIALIZERPTR pData, double Value)
+/* Whole arrays in one copy instead of a call (and a byte loop) per element */
+void PnWriteInt16Array(PNSERIALIZERPTR pData, const int16_t* pValues, uint32_t nCount)
 {
-    static const size_t Float64Size = sizeof(double);
+    _PnSer_WriteArray(pData, pValues, nCount, sizeof(int16_t), 1);
+    return;
+}
 
-    union
-    {
-        double F64;
-        char FloatBytes[Float64Size];
-    } __u;
-    __u.F64 = Value;
+void PnWriteInt32Array(PNSERIALIZERPTR pData, const int32_t* pValues, uint32_t nCount)
+{
+    _PnSer_WriteArray(pData, pValues, nCount, sizeof(int32_t), 1);
+    return;
+}
 
-    uint32_t k;
-    for (k = 0; k < Float64Size; k++)
-        pData->pPos[k] = __u.FloatBytes[k];
+void PnWriteInt64Array(PNSERIALIZERPTR pData, const int64_t* pValues, uint32_t nCount)
+{
+    _PnSer_WriteArray(pData, pValues, nCount, sizeof(int64_t), 1);
+    return;
+}
 
-    pData->pPos += Float64Size;
-    pData->Size += Float64Size;
+void PnWriteFloat32Array(PNSERIALIZERPTR pData, const float* pValues, uint32_t nCount)
+{
+    _PnSer_WriteArray(pData, pValues, nCount, sizeof(float), 0);
+    return;
+}
 
+void PnWriteFloat64Array(PNSERIALIZERPTR pData, const double* pValues, uint32_t nCount)
+{
+    _PnSer_WriteArray(pData, pValues, nCount, sizeof(double), 0);
     return;
 }
 
 
 void PnReadBytes(PNSERIALIZERPTR pData, void** pBytes, uint32_t* pSize)
 {
-    int32_t nSize = PnReadInt32(pData);
+    int32_t nSize = _PnSer_GetLength(pData, sizeof(int32_t));
+
+    if (pSize != NULL) *pSize = 0;
+    if (!_PnSer_Need(pData, nSize < 0 ? UINT64_MAX : (uint64_t)nSize) || (*pBytes = malloc(nSize + 1)) == NULL)
+    {
+        pData->Flags |= PN_SER_ERROR;
+        *pBytes = NULL;
+        return;
+    }
 
-    *pBytes = malloc(nSize);
-    *pBytes = memcpy(*pBytes, pData->pPos, nSize);
+    memcpy(*pBytes, pData->pPos, nSize);
     if (pSize != NULL) *pSize = nSize;
 
     pData->pPos += nSize;
@@ -330,9 +1587,16 @@ void PnReadBytes(PNSERIALIZERPTR pData, void** pBytes, uint32_t* pSize)
 
 void PnReadString(PNSERIALIZERPTR pData, char** lpstrString, int32_t* pLength)
 {
-    int32_t nLength = PnReadInt16(pData);
+    int32_t nLength = _PnSer_GetLength(pData, sizeof(int16_t));
+
+    if (pLength != NULL) *pLength = 0;
+    if (!_PnSer_Need(pData, nLength < 0 ? UINT64_MAX : (uint64_t)nLength) || (*lpstrString = malloc(nLength + 1)) == NULL)
+    {
+        pData->Flags |= PN_SER_ERROR;
+        *lpstrString = NULL;
+        return;
+    }
 
-    *lpstrString = malloc(nLength + 1);
     *lpstrString = strncpy(*lpstrString, pData->pPos, nLength);
     (*lpstrString)[nLength] = 0;
     if (pLength != NULL) *pLength = nLength;
@@ -341,6 +1605,31 @@ void PnReadString(PNSERIALIZERPTR pData, char** lpstrString, int32_t* pLength)
     return;
 }
 
+/* Views: no allocation or copy, the result points into the buffer (or mapping) and is not NUL-terminated */
+void PnReadBytesView(PNSERIALIZERPTR pData, const void** pBytes, uint32_t* pSize)
+{
+    int32_t nSize = _PnSer_GetLength(pData, sizeof(int32_t));
+
+    if (!_PnSer_Need(pData, nSize < 0 ? UINT64_MAX : (uint64_t)nSize)) nSize = 0;
+    *pBytes = pData->pPos;
+    if (pSize != NULL) *pSize = nSize;
+
+    pData->pPos += nSize;
+    return;
+}
+
+void PnReadStringView(PNSERIALIZERPTR pData, const char** lpstrString, int32_t* pLength)
+{
+    int32_t nLength = _PnSer_GetLength(pData, sizeof(int16_t));
+
+    if (!_PnSer_Need(pData, nLength < 0 ? UINT64_MAX : (uint64_t)nLength)) nLength = 0;
+    *lpstrString = pData->pPos;
+    if (pLength != NULL) *pLength = nLength;
+
+    pData->pPos += nLength;
+    return;
+}
+
 void PnReadDatetime(PNSERIALIZERPTR pData, struct tm** pDatetime)
 {
     time_t Time = 0;
@@ -356,74 +1645,95 @@ void PnReadDatetime(PNSERIALIZERPTR pData, struct tm** pDatetime)
 
 int16_t PnReadInt16(PNSERIALIZERPTR pData)
 {
-    union { int16_t I16; char I8[2]; } __u;
+    int16_t Value;
 
-    __u.I8[0] = pData->pPos[0];
-    __u.I8[1] = pData->pPos[1];
+    if (pData->Flags & PN_SER_VARINT) return (int16_t)_PnSer_UnZigZag(_PnSer_GetVarint(pData));
+    if (!_PnSer_Need(pData, sizeof(int16_t))) return 0;
+    Value = (int16_t)_PnSer_Load16(pData->pPos);
     pData->pPos += sizeof(int16_t);
 
-    return __u.I16;
+    return Value;
 }
 
 int32_t PnReadInt32(PNSERIALIZERPTR pData)
 {
-    union { int32_t I32; char I8[4]; } __u;
+    int32_t Value;
 
-    __u.I8[0] = pData->pPos[0];
-    __u.I8[1] = pData->pPos[1];
-    __u.I8[2] = pData->pPos[2];
-    __u.I8[3] = pData->pPos[3];
+    if (pData->Flags & PN_SER_VARINT) return (int32_t)_PnSer_UnZigZag(_PnSer_GetVarint(pData));
+    if (!_PnSer_Need(pData, sizeof(int32_t))) return 0;
+    Value = (int32_t)_PnSer_Load32(pData->pPos);
     pData->pPos += sizeof(int32_t);
 
-    return __u.I32;
+    return Value;
 }
 
 int64_t PnReadInt64(PNSERIALIZERPTR pData)
 {
-    union { int64_t I64; int32_t I32[2]; } __u;
+    int64_t Value;
 
-    __u.I32[0] = PnReadInt32(pData);
-    __u.I32[1] = PnReadInt32(pData);
+    if (pData->Flags & PN_SER_VARINT) return _PnSer_UnZigZag(_PnSer_GetVarint(pData));
+    if (!_PnSer_Need(pData, sizeof(int64_t))) return 0;
+    Value = (int64_t)_PnSer_Load64(pData->pPos);
+    pData->pPos += sizeof(int64_t);
 
-    return __u.I64;
+    return Value;
 }
 
 float PnReadFloat32(PNSERIALIZERPTR pData)
 {
-    static const size_t Float32Size = sizeof(float);
+    uint32_t Bits;
+    float Value;
 
-    union
-    {
-        float F32;
-        char FloatBytes[Float32Size];
-    } __u;
+    if (!_PnSer_Need(pData, sizeof(float))) return 0.0f;
+    Bits = _PnSer_Load32(pData->pPos);
+    memcpy(&Value, &Bits, sizeof(float));
+    pData->pPos += sizeof(float);
 
-    uint32_t k;
-    for (k = 0; k < Float32Size; k++)
-        __u.FloatBytes[k] = pData->pPos[k];
+    return Value;
+}
 
-    pData->pPos += Float32Size;
+double PnReadFloat64(PNSERIALIZERPTR pData)
+{
+    uint64_t Bits;
+    double Value;
+
+    if (!_PnSer_Need(pData, sizeof(double))) return 0.0;
+    Bits = _PnSer_Load64(pData->pPos);
+    memcpy(&Value, &Bits, sizeof(double));
+    pData->pPos += sizeof(double);
 
-    return __u.F32;
+    return Value;
 }
 
-double PnReadFloat64(PNSERIALIZERPTR pData)
+/* The arrays are malloc'd like PnReadBytes, free them yourself or through PnDeserializationEnd */
+void PnReadInt16Array(PNSERIALIZERPTR pData, int16_t** pValues, uint32_t* pCount)
 {
-    static const size_t Float64Size = sizeof(double);
+    *pValues = (int16_t*)_PnSer_ReadArray(pData, sizeof(int16_t), 1, pCount);
+    return;
+}
 
-    union
-    {
-        double F64;
-        char FloatBytes[Float64Size];
-    } __u;
+void PnReadInt32Array(PNSERIALIZERPTR pData, int32_t** pValues, uint32_t* pCount)
+{
+    *pValues = (int32_t*)_PnSer_ReadArray(pData, sizeof(int32_t), 1, pCount);
+    return;
+}
 
-    uint32_t k;
-    for (k = 0; k < Float64Size; k++)
-        __u.FloatBytes[k] = pData->pPos[k];
+void PnReadInt64Array(PNSERIALIZERPTR pData, int64_t** pValues, uint32_t* pCount)
+{
+    *pValues = (int64_t*)_PnSer_ReadArray(pData, sizeof(int64_t), 1, pCount);
+    return;
+}
 
-    pData->pPos += Float64Size;
+void PnReadFloat32Array(PNSERIALIZERPTR pData, float** pValues, uint32_t* pCount)
+{
+    *pValues = (float*)_PnSer_ReadArray(pData, sizeof(float), 0, pCount);
+    return;
+}
 
-    return __u.F64;
+void PnReadFloat64Array(PNSERIALIZERPTR pData, double** pValues, uint32_t* pCount)
+{
+    *pValues = (double*)_PnSer_ReadArray(pData, sizeof(double), 0, pCount);
+    return;
 }
 
 #endif // PN_SERIALIZER_IMPLEMENTATION